@@ -0,0 +1,339 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- throughput benchmarks
+
+ Run as
+ ./iplc-bench [length] [seed]
+ Prints one CSV row per benchmark.  The columns and row order only change
+ along with the format number in the first line, so two runs with the same
+ format can be diffed to spot a regression.
+ ***********************************************************************/
+/***********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "iplc-sim-internal.h"
+#include "iplc-tracegen.h"
+
+#define BENCH_FORMAT_VERSION 3
+#define BENCH_REPEATS 3 // report the best of this many runs
+
+typedef struct bench_geometry
+{
+    int index;
+    int blocksize;
+    int assoc;
+} bench_geometry_t;
+
+// Direct-mapped up to 64-way, all under MAX_CACHE_SIZE
+static const bench_geometry_t geometries[] = {
+    {7, 1, 1}, {6, 1, 2}, {5, 1, 4}, {4, 1, 8}, {3, 1, 16},
+    {2, 1, 32}, {0, 1, 64}, {5, 2, 1}, {4, 4, 2}
+};
+#define BENCH_GEOMETRIES (sizeof(geometries) / sizeof(geometries[0]))
+
+// Issue widths for the wide pipeline rows, all on the first geometry
+static const int issue_widths[] = { 1, 2, 4, 8 };
+#define BENCH_ISSUE_WIDTHS (sizeof(issue_widths) / sizeof(issue_widths[0]))
+
+// One generated trace, as text lines, records and the address stream
+typedef struct bench_trace
+{
+    int pattern;
+    size_t length;
+    char (*lines)[80];
+    iplc_sim_record_t *records;
+    size_t accesses;
+    unsigned int *addresses;
+    int *writes;
+} bench_trace_t;
+
+double bench_now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+void bench_report(const char *benchmark, int pattern, const bench_geometry_t *geometry,
+                  const char *unit, size_t items, double seconds)
+{
+    printf("%s,%s,", benchmark, pattern == -1 ? "-" : iplc_tracegen_pattern_name(pattern));
+    if (geometry) {
+        printf("%d,%d,%d,", geometry->index, geometry->blocksize, geometry->assoc);
+    } else {
+        printf("-,-,-,");
+    }
+    printf("%s,%lu,%.6f,%.0f\n", unit, (unsigned long) items, seconds, (double) items / seconds);
+}
+
+void bench_trace_generate(bench_trace_t *trace, int pattern, size_t length, unsigned int seed)
+{
+    iplc_tracegen_t gen;
+    char buffer[80];
+    size_t i;
+
+    trace->pattern = pattern;
+    trace->length = length;
+    trace->lines = malloc(length * sizeof(trace->lines[0]));
+    trace->records = malloc(length * sizeof(iplc_sim_record_t));
+    trace->addresses = malloc(2 * length * sizeof(unsigned int));
+    trace->writes = malloc(2 * length * sizeof(int));
+    trace->accesses = 0;
+
+    iplc_tracegen_init(&gen, pattern, seed);
+    for (i = 0; i < length; i++) {
+        iplc_tracegen_next(&gen, trace->lines[i], sizeof(trace->lines[i]));
+
+        //The parser writes into the line, so give it a copy
+        strcpy(buffer, trace->lines[i]);
+        if (iplc_sim_parse_instruction(buffer, &trace->records[i]) != 0) {
+            printf("Bad generated instruction: %s", trace->lines[i]);
+            exit(-1);
+        }
+
+        trace->addresses[trace->accesses] = trace->records[i].instruction_address;
+        trace->writes[trace->accesses++] = 0;
+        if (trace->records[i].type == IPLC_SIM_LW || trace->records[i].type == IPLC_SIM_SW) {
+            trace->addresses[trace->accesses] = trace->records[i].data_address;
+            trace->writes[trace->accesses++] = trace->records[i].type == IPLC_SIM_SW;
+        }
+    }
+}
+
+void bench_trace_free(bench_trace_t *trace)
+{
+    free(trace->lines);
+    free(trace->records);
+    free(trace->addresses);
+    free(trace->writes);
+}
+
+iplc_sim_t *bench_sim_wide(const bench_geometry_t *geometry, int issue_width)
+{
+    iplc_sim_config_t config = { geometry->index, geometry->blocksize, geometry->assoc, 0, 0, issue_width, 2, 1 };
+    iplc_sim_t *sim = iplc_sim_create();
+
+    if (iplc_sim_configure(sim, &config) != 0) {
+        printf("Cache too big for geometry %d %d %d\n", geometry->index, geometry->blocksize, geometry->assoc);
+        exit(-1);
+    }
+    return sim;
+}
+
+iplc_sim_t *bench_sim(const bench_geometry_t *geometry)
+{
+    return bench_sim_wide(geometry, 1);
+}
+
+/*
+ * Text line -> record, with no simulation behind it
+ */
+void bench_parse(const bench_trace_t *trace)
+{
+    iplc_sim_record_t record;
+    char buffer[80];
+    double best = 0, start, seconds;
+    size_t i;
+    int repeat;
+
+    for (repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+        start = bench_now();
+        for (i = 0; i < trace->length; i++) {
+            strcpy(buffer, trace->lines[i]);
+            iplc_sim_parse_instruction(buffer, &record);
+        }
+        seconds = bench_now() - start;
+        if (repeat == 0 || seconds < best) best = seconds;
+    }
+    bench_report("parse", trace->pattern, NULL, "instructions", trace->length, best);
+}
+
+/*
+ * Lookups (and the LRU work that goes with them) on the trace's address stream
+ */
+void bench_cache(const bench_trace_t *trace, const bench_geometry_t *geometry)
+{
+    double best = 0, start, seconds;
+    size_t i;
+    int repeat;
+
+    for (repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+        iplc_sim_t *sim = bench_sim(geometry);
+
+        start = bench_now();
+        for (i = 0; i < trace->accesses; i++) {
+            iplc_sim_trap_address(sim, trace->addresses[i], trace->writes[i]);
+        }
+        seconds = bench_now() - start;
+        if (repeat == 0 || seconds < best) best = seconds;
+
+        iplc_sim_destroy(sim);
+    }
+    bench_report("cache", trace->pattern, geometry, "accesses", trace->accesses, best);
+}
+
+/*
+ * Just the LRU bookkeeping for a hit, on random lines and ways
+ */
+void bench_lru(const bench_geometry_t *geometry, size_t length, unsigned int seed)
+{
+    unsigned int random = seed ? seed : 1;
+    int *indexes = malloc(length * sizeof(int));
+    int *entries = malloc(length * sizeof(int));
+    double best = 0, start, seconds;
+    size_t i;
+    int repeat;
+
+    for (i = 0; i < length; i++) {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        indexes[i] = random % (1 << geometry->index);
+        entries[i] = (random >> 16) % geometry->assoc;
+    }
+
+    for (repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+        iplc_sim_t *sim = bench_sim(geometry);
+
+        start = bench_now();
+        for (i = 0; i < length; i++) {
+            iplc_sim_LRU_update_on_hit(sim, indexes[i], entries[i]);
+        }
+        seconds = bench_now() - start;
+        if (repeat == 0 || seconds < best) best = seconds;
+
+        iplc_sim_destroy(sim);
+    }
+    bench_report("lru", -1, geometry, "accesses", length, best);
+
+    free(indexes);
+    free(entries);
+}
+
+/*
+ * The whole model: fetch, pipeline, hazards and data accesses
+ */
+void bench_pipeline(const bench_trace_t *trace, const bench_geometry_t *geometry, iplc_sim_stats_t *stats)
+{
+    double best = 0, start, seconds;
+    int repeat;
+
+    for (repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+        iplc_sim_t *sim = bench_sim(geometry);
+
+        start = bench_now();
+        iplc_sim_feed(sim, trace->records, trace->length);
+        iplc_sim_drain_pipeline(sim);
+        seconds = bench_now() - start;
+        if (repeat == 0 || seconds < best) best = seconds;
+
+        iplc_sim_get_stats(sim, stats);
+        iplc_sim_destroy(sim);
+    }
+    bench_report("pipeline", trace->pattern, geometry, "instructions", trace->length, best);
+}
+
+/*
+ * The whole model again, issuing more than one instruction a cycle.  Time
+ * per instruction should stay about the same however wide it gets.
+ */
+void bench_pipeline_wide(const bench_trace_t *trace, const bench_geometry_t *geometry, int issue_width)
+{
+    char benchmark[32];
+    double best = 0, start, seconds;
+    int repeat;
+
+    for (repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+        iplc_sim_t *sim = bench_sim_wide(geometry, issue_width);
+
+        start = bench_now();
+        iplc_sim_feed(sim, trace->records, trace->length);
+        iplc_sim_drain_pipeline(sim);
+        seconds = bench_now() - start;
+        if (repeat == 0 || seconds < best) best = seconds;
+
+        iplc_sim_destroy(sim);
+    }
+    snprintf(benchmark, sizeof(benchmark), "pipeline-%d-wide", issue_width);
+    bench_report(benchmark, trace->pattern, geometry, "instructions", trace->length, best);
+}
+
+/*
+ * The same cache accesses as the pipeline, without the pipeline.  Also makes
+ * sure the hits and misses really do come out the same.
+ */
+void bench_cache_only(const bench_trace_t *trace, const bench_geometry_t *geometry,
+                      const iplc_sim_stats_t *expected)
+{
+    iplc_sim_stats_t stats;
+    double best = 0, start, seconds;
+    int repeat;
+
+    for (repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+        iplc_sim_t *sim = bench_sim(geometry);
+
+        start = bench_now();
+        iplc_sim_feed_cache_only(sim, trace->records, trace->length);
+        iplc_sim_drain_pipeline(sim);
+        seconds = bench_now() - start;
+        if (repeat == 0 || seconds < best) best = seconds;
+
+        iplc_sim_get_stats(sim, &stats);
+        iplc_sim_destroy(sim);
+    }
+
+    if (stats.cache_hit != expected->cache_hit || stats.cache_miss != expected->cache_miss) {
+        printf("Cache-only run disagrees with the pipeline for %s %d %d %d\n",
+               iplc_tracegen_pattern_name(trace->pattern),
+               geometry->index, geometry->blocksize, geometry->assoc);
+        exit(-1);
+    }
+    bench_report("cache-only", trace->pattern, geometry, "instructions", trace->length, best);
+}
+
+int main(int argc, char **argv)
+{
+    size_t length = 1000000;
+    unsigned int seed = 1;
+    bench_trace_t trace;
+    iplc_sim_stats_t stats;
+    size_t g;
+    int pattern;
+
+    if (argc > 1) {
+        length = strtoul(argv[1], NULL, 0);
+    }
+    if (argc > 2) {
+        seed = (unsigned int) strtoul(argv[2], NULL, 0);
+    }
+
+    printf("# iplc-bench format %d length %lu seed %u\n", BENCH_FORMAT_VERSION, (unsigned long) length, seed);
+    printf("benchmark,pattern,index,blocksize,assoc,unit,items,seconds,items_per_sec\n");
+
+    for (pattern = 0; pattern < IPLC_TRACEGEN_PATTERNS; pattern++) {
+        bench_trace_generate(&trace, pattern, length, seed);
+
+        bench_parse(&trace);
+        for (g = 0; g < BENCH_GEOMETRIES; g++) {
+            bench_cache(&trace, &geometries[g]);
+        }
+        for (g = 0; g < BENCH_GEOMETRIES; g++) {
+            bench_pipeline(&trace, &geometries[g], &stats);
+            bench_cache_only(&trace, &geometries[g], &stats);
+        }
+        for (g = 0; g < BENCH_ISSUE_WIDTHS; g++) {
+            bench_pipeline_wide(&trace, &geometries[0], issue_widths[g]);
+        }
+
+        bench_trace_free(&trace);
+    }
+
+    for (g = 0; g < BENCH_GEOMETRIES; g++) {
+        bench_lru(&geometries[g], length, seed);
+    }
+
+    return 0;
+}
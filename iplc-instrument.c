@@ -0,0 +1,159 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- hot-path instrumentation
+ ***********************************************************************/
+/***********************************************************************/
+#include "iplc-instrument.h"
+
+#ifdef IPLC_SIM_INSTRUMENT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#define IPLC_PERF_COUNTERS 4
+
+__thread iplc_instrument_thread_t iplc_instrument_thread;
+
+static const char *phase_names[IPLC_PHASES] = { "other", "parse", "cache", "pipeline", "output", "wait" };
+
+// Every thread's phases, once it's done with them
+static unsigned long long total_ticks[IPLC_PHASES];
+static unsigned long long total_calls[IPLC_PHASES];
+static pthread_mutex_t total_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Ticks and seconds at the start, to work out how long a tick is
+static unsigned long long start_ticks;
+static double start_seconds;
+
+#ifdef __linux__
+static const struct
+{
+    const char *name;
+    unsigned long long config;
+} perf_counters[IPLC_PERF_COUNTERS] = {
+    { "cycles", PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions", PERF_COUNT_HW_INSTRUCTIONS },
+    { "cache misses", PERF_COUNT_HW_CACHE_MISSES },
+    { "branch misses", PERF_COUNT_HW_BRANCH_MISSES }
+};
+static int perf_fds[IPLC_PERF_COUNTERS] = { -1, -1, -1, -1 };
+#endif
+
+static double iplc_instrument_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+#ifdef __linux__
+/*
+ * Counts for this process and every thread it starts from here on, in user
+ * space only.  Returns -1 if the kernel won't let us (no PMU, or
+ * perf_event_paranoid too high).
+ */
+static int iplc_instrument_open_counter(unsigned long long config)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+void iplc_instrument_thread_done(void)
+{
+    iplc_instrument_thread_t *thread = &iplc_instrument_thread;
+    int i;
+
+    //Whatever is still running gets charged up to now
+    iplc_instrument_charge(thread);
+
+    pthread_mutex_lock(&total_lock);
+    for (i = 0; i < IPLC_PHASES; i++) {
+        total_ticks[i] += thread->ticks[i];
+        total_calls[i] += thread->calls[i];
+    }
+    pthread_mutex_unlock(&total_lock);
+
+    memset(thread, 0, sizeof(iplc_instrument_thread_t));
+}
+
+static void iplc_instrument_report(void)
+{
+    unsigned long long ticks = 0;
+    double seconds, ticks_per_second;
+    int i;
+
+    iplc_instrument_thread_done();
+    seconds = iplc_instrument_seconds() - start_seconds;
+    ticks_per_second = seconds > 0 ? (double) (iplc_instrument_now() - start_ticks) / seconds : 1;
+
+    for (i = 0; i < IPLC_PHASES; i++) {
+        ticks += total_ticks[i];
+    }
+
+    //Multi-core runs add up every thread, so this can be more than wall time
+    fprintf(stderr, "Host Time Breakdown (%.6f s wall) \n", seconds);
+    for (i = 0; i < IPLC_PHASES; i++) {
+        fprintf(stderr, "\t %-8s %12.6f s %6.2f%% %12llu calls %10.1f ticks/call \n",
+                phase_names[i], (double) total_ticks[i] / ticks_per_second,
+                ticks ? 100.0 * (double) total_ticks[i] / (double) ticks : 0.0,
+                total_calls[i], total_calls[i] ? (double) total_ticks[i] / (double) total_calls[i] : 0.0);
+    }
+
+#ifdef __linux__
+    if (perf_fds[0] != -1 || perf_fds[1] != -1 || perf_fds[2] != -1 || perf_fds[3] != -1) {
+        fprintf(stderr, "Host Counters \n");
+        for (i = 0; i < IPLC_PERF_COUNTERS; i++) {
+            unsigned long long value;
+
+            if (perf_fds[i] == -1 || read(perf_fds[i], &value, sizeof(value)) != sizeof(value)) {
+                fprintf(stderr, "\t %-14s unavailable \n", perf_counters[i].name);
+            } else {
+                fprintf(stderr, "\t %-14s %llu \n", perf_counters[i].name, value);
+            }
+            if (perf_fds[i] != -1) {
+                close(perf_fds[i]);
+            }
+        }
+    } else if (getenv("IPLC_SIM_PERF_COUNTERS")) {
+        fprintf(stderr, "Host Counters unavailable (check perf_event_paranoid) \n");
+    }
+#endif
+}
+
+void iplc_instrument_start(void)
+{
+#ifdef __linux__
+    int i;
+
+    if (getenv("IPLC_SIM_PERF_COUNTERS")) {
+        for (i = 0; i < IPLC_PERF_COUNTERS; i++) {
+            perf_fds[i] = iplc_instrument_open_counter(perf_counters[i].config);
+        }
+    }
+#endif
+
+    start_seconds = iplc_instrument_seconds();
+    start_ticks = iplc_instrument_now();
+    iplc_instrument_thread.mark = start_ticks;
+    atexit(iplc_instrument_report);
+}
+
+#endif // IPLC_SIM_INSTRUMENT
@@ -0,0 +1,148 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- hot-path instrumentation
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_INSTRUMENT_H
+#define IPLC_INSTRUMENT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Where the simulator's own time goes, split into a few phases.  Build with
+ * IPLC_SIM_INSTRUMENT defined to turn it on; without it every macro below is
+ * empty and nothing is timed or counted.
+ *
+ * Phases nest (a pipeline push does cache lookups), and each tick is only
+ * charged to the innermost phase running at the time, so the phases add up
+ * to the whole run.  Anything outside every phase is "other".  Time is read
+ * from the TSC on x86 and from clock_gettime() anywhere else.
+ *
+ * In a multi-core run each core's thread keeps its own breakdown, and the
+ * time cores spend waiting for each other at the end of a quantum is "wait".
+ * The main thread's clock is paused while it waits for the cores to finish,
+ * so that time isn't counted twice.
+ *
+ * If IPLC_SIM_PERF_COUNTERS is set in the environment, host cycles,
+ * instructions, cache misses and branch misses for the whole run are also
+ * counted with perf_event_open() (Linux only).
+ *
+ * The breakdown goes to stderr when the process exits.
+ */
+enum iplc_instrument_phase
+{
+    IPLC_PHASE_OTHER,
+    IPLC_PHASE_PARSE,       // reading and decoding trace records
+    IPLC_PHASE_CACHE,       // cache lookups and LRU updates
+    IPLC_PHASE_PIPELINE,    // moving instructions through the pipeline
+    IPLC_PHASE_OUTPUT,      // pipeline dumps and printed stats
+    IPLC_PHASE_WAIT,        // cores waiting for each other at a quantum barrier
+    IPLC_PHASES
+};
+
+#ifdef IPLC_SIM_INSTRUMENT
+
+#include <assert.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+#define IPLC_INSTRUMENT_DEPTH 8 // deepest phases ever nest
+
+// One per thread, so simulated cores never share (or lock) a timer
+typedef struct iplc_instrument_thread
+{
+    unsigned long long mark;            // when time was last charged
+    unsigned long long ticks[IPLC_PHASES];
+    unsigned long long calls[IPLC_PHASES];
+    int stack[IPLC_INSTRUMENT_DEPTH];
+    int depth;
+} iplc_instrument_thread_t;
+
+extern __thread iplc_instrument_thread_t iplc_instrument_thread;
+
+// Start the clock and counters, and print the breakdown at exit
+void iplc_instrument_start(void);
+// Add this thread's phases to the totals before it goes away
+void iplc_instrument_thread_done(void);
+
+static inline unsigned long long iplc_instrument_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long) now.tv_sec * 1000000000ULL + now.tv_nsec;
+#endif
+}
+
+static inline void iplc_instrument_charge(iplc_instrument_thread_t *thread)
+{
+    unsigned long long now = iplc_instrument_now();
+
+    //A thread's first phase has nothing before it to charge
+    if (thread->mark) {
+        thread->ticks[thread->depth ? thread->stack[thread->depth - 1] : IPLC_PHASE_OTHER] += now - thread->mark;
+    }
+    thread->mark = now;
+}
+
+// Stop charging this thread's time to anything until it resumes
+static inline void iplc_instrument_pause(void)
+{
+    iplc_instrument_charge(&iplc_instrument_thread);
+    iplc_instrument_thread.mark = 0;
+}
+
+static inline void iplc_instrument_resume(void)
+{
+    iplc_instrument_thread.mark = iplc_instrument_now();
+}
+
+static inline void iplc_instrument_begin(int phase)
+{
+    iplc_instrument_thread_t *thread = &iplc_instrument_thread;
+
+    iplc_instrument_charge(thread);
+    thread->calls[phase]++;
+    assert(thread->depth < IPLC_INSTRUMENT_DEPTH);
+    thread->stack[thread->depth++] = phase;
+}
+
+static inline void iplc_instrument_end(int phase)
+{
+    iplc_instrument_thread_t *thread = &iplc_instrument_thread;
+
+    iplc_instrument_charge(thread);
+    assert(thread->depth > 0 && thread->stack[thread->depth - 1] == phase);
+    thread->depth--;
+}
+
+#define IPLC_INSTRUMENT_START() iplc_instrument_start()
+#define IPLC_INSTRUMENT_THREAD_DONE() iplc_instrument_thread_done()
+#define IPLC_INSTRUMENT_PAUSE() iplc_instrument_pause()
+#define IPLC_INSTRUMENT_RESUME() iplc_instrument_resume()
+#define IPLC_INSTRUMENT_BEGIN(phase) iplc_instrument_begin(phase)
+#define IPLC_INSTRUMENT_END(phase) iplc_instrument_end(phase)
+
+#else
+
+#define IPLC_INSTRUMENT_START() ((void) 0)
+#define IPLC_INSTRUMENT_THREAD_DONE() ((void) 0)
+#define IPLC_INSTRUMENT_PAUSE() ((void) 0)
+#define IPLC_INSTRUMENT_RESUME() ((void) 0)
+#define IPLC_INSTRUMENT_BEGIN(phase) ((void) 0)
+#define IPLC_INSTRUMENT_END(phase) ((void) 0)
+
+#endif // IPLC_SIM_INSTRUMENT
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IPLC_INSTRUMENT_H
@@ -0,0 +1,216 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- on-disk result cache
+ ***********************************************************************/
+/***********************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "iplc-result-cache.h"
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+// 64-bit FNV-1a, carried on from a previous hash
+static unsigned long long iplc_result_cache_fnv(unsigned long long hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char *) data;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+int iplc_result_cache_hash_file(const char *path, unsigned long long *trace_hash)
+{
+    unsigned char buffer[65536];
+    unsigned long long hash = FNV_OFFSET_BASIS;
+    FILE *file = fopen(path, "rb");
+    size_t size;
+
+    if (file == NULL) {
+        return -1;
+    }
+    while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        hash = iplc_result_cache_fnv(hash, buffer, size);
+    }
+    if (ferror(file)) {
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+
+    *trace_hash = hash;
+    return 0;
+}
+
+// The issue settings as the simulator will use them, so 0 and 1 are one key
+static void iplc_result_cache_issue_key(const iplc_sim_config_t *config, int issue[3])
+{
+    issue[0] = config->issue_width > 0 ? config->issue_width : 1;
+    issue[1] = config->memory_ports > 0 ? config->memory_ports : 1;
+    issue[2] = config->branch_units > 0 ? config->branch_units : 1;
+}
+
+/*
+ * Entries are named by a hash of the whole key.  The model version is left
+ * out of the name on purpose, so a new version reuses (and replaces) the
+ * old version's file instead of leaving it behind.
+ */
+static void iplc_result_cache_path(char *path, size_t size, const char *dir,
+                            unsigned long long trace_hash, const iplc_sim_config_t *config)
+{
+    unsigned long long hash = FNV_OFFSET_BASIS;
+    int key[4];
+    int issue[3];
+
+    key[0] = config->index;
+    key[1] = config->blocksize;
+    key[2] = config->assoc;
+    key[3] = (int) config->branch_predict_taken;
+
+    hash = iplc_result_cache_fnv(hash, &trace_hash, sizeof(trace_hash));
+    hash = iplc_result_cache_fnv(hash, key, sizeof(key));
+    //Single-issue runs keep the names they had before there was a choice
+    iplc_result_cache_issue_key(config, issue);
+    if (issue[0] != 1 || issue[1] != 1 || issue[2] != 1) {
+        hash = iplc_result_cache_fnv(hash, issue, sizeof(issue));
+    }
+    snprintf(path, size, "%s/%016llx.txt", dir, hash);
+}
+
+int iplc_result_cache_lookup(const char *dir, unsigned long long trace_hash,
+                             const iplc_sim_config_t *config, iplc_sim_stats_t *stats)
+{
+    char path[1024];
+    FILE *file;
+    int version, index, blocksize, assoc;
+    unsigned int branch_predict_taken;
+    unsigned long long hash;
+    iplc_sim_stats_t found;
+    int issue[3], found_issue[3] = {0, 0, 0};
+    int fields, issue_fields, i;
+
+    iplc_result_cache_path(path, sizeof(path), dir, trace_hash, config);
+    file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+
+    memset(&found, 0, sizeof(iplc_sim_stats_t));
+    fields = fscanf(file,
+                    "model_version %d\n"
+                    "trace_hash %llx\n"
+                    "index %d\n"
+                    "blocksize %d\n"
+                    "assoc %d\n"
+                    "branch_predict_taken %u\n"
+                    "cache_access %ld\n"
+                    "cache_miss %ld\n"
+                    "cache_hit %ld\n"
+                    "pipeline_cycles %u\n"
+                    "instruction_count %u\n"
+                    "branch_count %u\n"
+                    "correct_branch_predictions %u\n",
+                    &version, &hash, &index, &blocksize, &assoc, &branch_predict_taken,
+                    &found.cache_access, &found.cache_miss, &found.cache_hit,
+                    &found.pipeline_cycles, &found.instruction_count,
+                    &found.branch_count, &found.correct_branch_predictions);
+    if (fields == 13) {
+        issue_fields = fscanf(file,
+                              "issue_width %d\n"
+                              "memory_ports %d\n"
+                              "branch_units %d\n"
+                              "issue_cycles",
+                              &found_issue[0], &found_issue[1], &found_issue[2]);
+        if (issue_fields == EOF) {
+            //Saved before the issue width was a setting, so single-issue, with
+            // no histogram to go with it
+            found_issue[0] = found_issue[1] = found_issue[2] = 1;
+            fields = 17 + IPLC_SIM_MAX_ISSUE_WIDTH;
+        } else {
+            fields += issue_fields;
+        }
+    }
+    for (i = 0; fields == 16 + i && i <= IPLC_SIM_MAX_ISSUE_WIDTH; i++) {
+        fields += fscanf(file, " %u", &found.issue_cycles[i]);
+    }
+    fclose(file);
+    found.issue_width = found_issue[0];
+    iplc_result_cache_issue_key(config, issue);
+
+    //Half-written, from another version of the model, or a hash collision
+    if (fields != 17 + IPLC_SIM_MAX_ISSUE_WIDTH ||
+        version != IPLC_SIM_MODEL_VERSION ||
+        hash != trace_hash ||
+        index != config->index ||
+        blocksize != config->blocksize ||
+        assoc != config->assoc ||
+        branch_predict_taken != config->branch_predict_taken ||
+        memcmp(found_issue, issue, sizeof(issue)) != 0) {
+        return 0;
+    }
+
+    *stats = found;
+    return 1;
+}
+
+int iplc_result_cache_store(const char *dir, unsigned long long trace_hash,
+                            const iplc_sim_config_t *config, const iplc_sim_stats_t *stats)
+{
+    char path[1024];
+    char temp_path[1100];
+    FILE *file;
+    int issue[3];
+    int i;
+
+    iplc_result_cache_path(path, sizeof(path), dir, trace_hash, config);
+    //Write it somewhere else first so nobody ever reads half an entry
+    snprintf(temp_path, sizeof(temp_path), "%s.%ld.tmp", path, (long) getpid());
+
+    file = fopen(temp_path, "w");
+    if (file == NULL) {
+        return -1;
+    }
+    fprintf(file,
+            "model_version %d\n"
+            "trace_hash %016llx\n"
+            "index %d\n"
+            "blocksize %d\n"
+            "assoc %d\n"
+            "branch_predict_taken %u\n"
+            "cache_access %ld\n"
+            "cache_miss %ld\n"
+            "cache_hit %ld\n"
+            "pipeline_cycles %u\n"
+            "instruction_count %u\n"
+            "branch_count %u\n"
+            "correct_branch_predictions %u\n",
+            IPLC_SIM_MODEL_VERSION, trace_hash, config->index, config->blocksize, config->assoc,
+            config->branch_predict_taken,
+            stats->cache_access, stats->cache_miss, stats->cache_hit,
+            stats->pipeline_cycles, stats->instruction_count,
+            stats->branch_count, stats->correct_branch_predictions);
+
+    iplc_result_cache_issue_key(config, issue);
+    fprintf(file,
+            "issue_width %d\n"
+            "memory_ports %d\n"
+            "branch_units %d\n"
+            "issue_cycles",
+            issue[0], issue[1], issue[2]);
+    for (i = 0; i <= IPLC_SIM_MAX_ISSUE_WIDTH; i++) {
+        fprintf(file, " %u", stats->issue_cycles[i]);
+    }
+    fprintf(file, "\n");
+
+    if (fclose(file) != 0 || rename(temp_path, path) != 0) {
+        remove(temp_path);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,39 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- on-disk result cache
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_RESULT_CACHE_H
+#define IPLC_RESULT_CACHE_H
+
+#include "iplc-sim.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Final stats of single-core runs, saved one file per run in a directory.
+ * A run is identified by a hash of the trace file's contents plus the cache
+ * geometry, branch prediction and issue width it was simulated with.  Every entry also
+ * records IPLC_SIM_MODEL_VERSION, and entries from any other version are
+ * ignored (and overwritten by the next store).  Entries saved before the issue
+ * width was a setting have no issue lines and are read as single-issue.
+ */
+
+// Hash of everything in the file.  Returns -1 if it can't be read.
+int iplc_result_cache_hash_file(const char *path, unsigned long long *trace_hash);
+
+// Returns 1 and fills in stats if we have this run, otherwise 0
+int iplc_result_cache_lookup(const char *dir, unsigned long long trace_hash,
+                             const iplc_sim_config_t *config, iplc_sim_stats_t *stats);
+
+// Returns -1 if the entry couldn't be written
+int iplc_result_cache_store(const char *dir, unsigned long long trace_hash,
+                            const iplc_sim_config_t *config, const iplc_sim_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IPLC_RESULT_CACHE_H
@@ -0,0 +1,48 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- internals shared with the benchmarks
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_SIM_INTERNAL_H
+#define IPLC_SIM_INTERNAL_H
+
+#include "iplc-sim.h"
+
+// init the simulator
+int iplc_sim_init(iplc_sim_t *sim, int index, int blocksize, int assoc);
+int iplc_sim_init_issue(iplc_sim_t *sim, int issue_width, int memory_ports, int branch_units);
+void iplc_sim_print_config(iplc_sim_t *sim);
+void iplc_sim_free_cache(iplc_sim_t *sim);
+
+// Cache simulator functions
+void iplc_sim_LRU_replace_on_miss(iplc_sim_t *sim, int index, int tag);
+void iplc_sim_LRU_update_on_hit(iplc_sim_t *sim, int index, int assoc);
+int iplc_sim_trap_address(iplc_sim_t *sim, unsigned int address, int is_write);
+
+// Coherence functions
+void iplc_sim_coherence_request(iplc_sim_t *sim, int index, int tag, int hit, int is_write);
+
+// Pipeline functions
+unsigned int iplc_sim_parse_reg(char *reg_str);
+void iplc_sim_fetch_instruction(iplc_sim_t *sim, unsigned int instruction_address);
+int iplc_sim_process_record(iplc_sim_t *sim, const iplc_sim_record_t *record);
+void iplc_sim_push_pipeline_stage(iplc_sim_t *sim);
+int iplc_sim_pipeline_busy(iplc_sim_t *sim);
+void iplc_sim_process_pipeline_rtype(iplc_sim_t *sim, char *instruction, int dest_reg,
+                                     int reg1, int reg2_or_constant);
+void iplc_sim_process_pipeline_lw(iplc_sim_t *sim, int dest_reg, int base_reg, unsigned int data_address);
+void iplc_sim_process_pipeline_sw(iplc_sim_t *sim, int src_reg, int base_reg, unsigned int data_address);
+void iplc_sim_process_pipeline_branch(iplc_sim_t *sim, int reg1, int reg2);
+void iplc_sim_process_pipeline_jump(iplc_sim_t *sim, char *instruction);
+void iplc_sim_process_pipeline_syscall(iplc_sim_t *sim);
+void iplc_sim_process_pipeline_nop(iplc_sim_t *sim);
+
+// Cache-only functions
+int iplc_sim_trap_address_fast(iplc_sim_t *sim, unsigned int address);
+void iplc_sim_push_cache_only(iplc_sim_t *sim);
+void iplc_sim_drain_cache_only(iplc_sim_t *sim);
+
+// Multi-core trace replay
+void *iplc_sim_core_thread(void *arg);
+
+#endif // IPLC_SIM_INTERNAL_H
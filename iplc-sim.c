@@ -9,67 +9,40 @@
 #include <stdint.h>
 #include <math.h>
 #include <assert.h>
+#include <pthread.h>
+
+#include "iplc-sim-internal.h"
+#include "iplc-trace.h"
+#include "iplc-instrument.h"
 
 #define MAX_CACHE_SIZE 10240
 #define CACHE_MISS_DELAY 10 // 10 cycle cache miss penalty
 #define MAX_STAGES 5
+#define MAX_CORES 16
+#define CORE_QUANTUM 1000 // cycles each core runs between barriers in multi-core replay
+#define COHERENCE_INVALIDATE_DELAY 2 // cycles to broadcast an invalidate on the bus
+#define COHERENCE_TRANSFER_DELAY 5 // cycles for a cache-to-cache transfer of a modified block
 #define byte int8_t //Could use char, but this seems... neater, somehow
 
-// init the simulator
-void iplc_sim_init(int index, int blocksize, int assoc);
-
-// Cache simulator functions
-void iplc_sim_LRU_replace_on_miss(int index, int tag);
-void iplc_sim_LRU_update_on_hit(int index, int assoc);
-int iplc_sim_trap_address(unsigned int address);
-
-// Pipeline functions
-unsigned int iplc_sim_parse_reg(char *reg_str);
-void iplc_sim_parse_instruction(char *buffer);
-void iplc_sim_push_pipeline_stage();
-void iplc_sim_process_pipeline_rtype(char *instruction, int dest_reg,
-                                     int reg1, int reg2_or_constant);
-void iplc_sim_process_pipeline_lw(int dest_reg, int base_reg, unsigned int data_address);
-void iplc_sim_process_pipeline_sw(int src_reg, int base_reg, unsigned int data_address);
-void iplc_sim_process_pipeline_branch(int reg1, int reg2);
-void iplc_sim_process_pipeline_jump(char *instruction);
-void iplc_sim_process_pipeline_syscall();
-void iplc_sim_process_pipeline_nop();
-
-// Output performance results
-void iplc_sim_finalize();
+/*
+ * MESI state of each cache slot, only tracked in multi-core replay.  A slot
+ * another core invalidated keeps its tag and sits in MESI_STALE until we
+ * miss on it (a coherence miss) or replace it.  A slot whose read or write
+ * hasn't been on the bus yet is MESI_REQUESTED_READ or _WRITE, and the other
+ * cores' traffic passes it by until it has.
+ */
+enum mesi_state {MESI_INVALID, MESI_SHARED, MESI_EXCLUSIVE, MESI_MODIFIED, MESI_STALE,
+                 MESI_REQUESTED_READ, MESI_REQUESTED_WRITE};
 
 typedef struct cache_line
 {
     byte* valid;
     int* tag;
     byte* last_accessed;
+    byte* state;
 
 } cache_line_t;
 
-cache_line_t *cache = NULL;
-int cache_index = 0;
-int cache_blocksize = 0;
-int cache_blockoffsetbits = 0;
-int cache_assoc = 0;
-long cache_miss = 0;
-long cache_access = 0;
-long cache_hit = 0;
-
-char instruction[16];
-char reg1[16];
-char reg2[16];
-char offsetwithreg[16];
-unsigned int data_address = 0;
-unsigned int instruction_address = 0;
-unsigned int pipeline_cycles = 0;   // how many cycles did you pipeline consume
-unsigned int instruction_count = 0; // home many real instructions ran thru the pipeline
-unsigned int branch_predict_taken = 0;
-unsigned int branch_count = 0;
-unsigned int correct_branch_predictions = 0;
-
-unsigned int dump_pipeline = 1;
-
 enum instruction_type {NOP, RTYPE, LW, SW, BRANCH, JUMP, JAL, SYSCALL};
 
 typedef struct rtype
@@ -123,7 +96,124 @@ typedef struct pipeline
 
 enum pipeline_stages {FETCH, DECODE, ALU, MEM, WRITEBACK};
 
-pipeline_t pipeline[MAX_STAGES];
+/*
+ * The instructions in one stage, in program order.  A single-issue pipeline
+ * only ever has one of them; a wider one fetches a group of up to
+ * issue_width together and they move down the pipeline as one.
+ */
+typedef struct pipeline_group
+{
+    pipeline_t slot[IPLC_SIM_MAX_ISSUE_WIDTH];
+    int count;
+    int memory_ops;             // slots that need a memory port
+    int branch_ops;             // slots that need a branch unit
+    unsigned int written_regs;  // one bit for each register a slot writes
+} pipeline_group_t;
+
+/*
+ * All a cache-only run keeps of each pipeline stage: enough to know when an
+ * instruction's data access happens, and nothing about timing.
+ */
+typedef struct cache_only_stage
+{
+    enum instruction_type itype;
+    unsigned int instruction_address;
+    unsigned int data_address;
+} cache_only_stage_t;
+
+typedef struct iplc_sim_system iplc_sim_system_t;
+
+// A request one core put on the bus during a quantum, for the others to snoop
+typedef struct bus_transaction
+{
+    unsigned int cycle;
+    int index;
+    int tag;
+    int is_write;
+} bus_transaction_t;
+
+/*
+ * Everything one simulated core owns: its private cache, its pipeline and
+ * its counters.  The single-core simulator runs exactly one of these.
+ */
+struct iplc_sim
+{
+    cache_line_t *cache;
+    int cache_index;
+    int cache_blocksize;
+    int cache_blockoffsetbits;
+    unsigned int cache_index_mask;  // index bits, once shifted down past the block offset
+    int cache_tag_shift;            // everything above the index is the tag
+    int cache_assoc;
+    unsigned long cache_size;
+    long cache_miss;
+    long cache_access;
+    long cache_hit;
+
+    unsigned int instruction_address;
+    unsigned int pipeline_cycles;   // how many cycles did you pipeline consume
+    unsigned int instruction_count; // home many real instructions ran thru the pipeline
+    unsigned int branch_predict_taken;
+    unsigned int branch_count;
+    unsigned int correct_branch_predictions;
+
+    unsigned int verbose;           // print every access and hit/miss as it happens
+
+    // Each stage points at one of the groups, so moving the pipeline along
+    // a stage is just passing the pointers down, however wide it is
+    pipeline_group_t *pipeline[MAX_STAGES];
+    pipeline_group_t pipeline_groups[MAX_STAGES];
+    int issue_width;
+    int memory_ports;
+    int branch_units;
+    unsigned int issue_cycles[IPLC_SIM_MAX_ISSUE_WIDTH + 1];
+
+    // Cache-only runs use this instead of the pipeline
+    unsigned int cache_only;
+    cache_only_stage_t cache_only_pipeline[MAX_STAGES];
+
+    // Multi-core replay only -- system is NULL when there is just one core
+    iplc_sim_system_t *system;
+    int core_id;
+    iplc_trace_t trace;
+    int finished;                   // out of trace (or failed) and drained
+    int failed;                     // stopped on a record we don't understand
+    bus_transaction_t *bus_log;     // this quantum's bus requests, oldest first
+    int bus_log_count;
+    int bus_log_size;
+    unsigned int coherence_delay;   // bus cycles not yet charged to the pipeline
+    long coherence_miss;
+    long coherence_invalidations;
+    long coherence_transfers;
+};
+
+/*
+ * Where the cores meet between quanta.  Built from a mutex and a condition
+ * variable, since pthread_barrier_t is optional in POSIX and macOS doesn't
+ * have it.
+ */
+typedef struct iplc_sim_barrier
+{
+    pthread_mutex_t lock;
+    pthread_cond_t everyone_here;
+    int count;              // threads that meet here
+    int waiting;            // how many have turned up this time
+    unsigned int round;     // goes up each time everyone has turned up
+} iplc_sim_barrier_t;
+
+/*
+ * The cores of a multi-core replay and the snooping bus that connects their
+ * private caches.  Cores only look at each other's caches between quanta,
+ * while everyone is at the barrier, so nothing here needs a lock.
+ */
+struct iplc_sim_system
+{
+    iplc_sim_t *cores[MAX_CORES];
+    int core_count;
+    int cores_running;
+    unsigned int quantum;
+    iplc_sim_barrier_t quantum_barrier;
+};
 
 /************************************************************************************************/
 /* Cache Functions ******************************************************************************/
@@ -132,10 +222,10 @@ pipeline_t pipeline[MAX_STAGES];
  * Correctly configure the cache.
  */
 // Returns -1 for a miss, and the cache slot on hit
-int cache_line_assoc_handler(cache_line_t line, int tag)
+static int cache_line_assoc_handler(iplc_sim_t *sim, cache_line_t line, int tag)
 {
     int i;
-    for (i = 0; i < cache_assoc; i++) {
+    for (i = 0; i < sim->cache_assoc; i++) {
 	    //If this is our line and it's valid, we've hit
         if (line.tag[i] == tag && line.valid[i]) return i;
     }
@@ -143,10 +233,10 @@ int cache_line_assoc_handler(cache_line_t line, int tag)
 }
 
 // Search the cache line for the least recently accessed element
-int cache_line_select_replace(cache_line_t line)
+static int cache_line_select_replace(iplc_sim_t *sim, cache_line_t line)
 {
     int i;
-    for (i = 0; i < cache_assoc; i++) {
+    for (i = 0; i < sim->cache_assoc; i++) {
 	    //If this line is free or the least recently used then we can use it
         if (line.last_accessed[i] == 0 || line.valid[i] == 0) return i;
     }
@@ -155,67 +245,155 @@ int cache_line_select_replace(cache_line_t line)
     return -1;
 }
 
-void iplc_sim_init(int index, int blocksize, int assoc)
+// Returns 1 if another core invalidated our copy of this tag, which makes
+// the miss we're about to take a coherence miss rather than a capacity one
+static int cache_line_coherence_lost(iplc_sim_t *sim, cache_line_t line, int tag)
+{
+    int i;
+    for (i = 0; i < sim->cache_assoc; i++) {
+        if (line.tag[i] == tag && !line.valid[i] && line.state[i] == MESI_STALE) {
+            //Only count it once
+            line.state[i] = MESI_INVALID;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Empty one stage of the pipeline
+static void iplc_sim_clear_group(pipeline_group_t *group)
+{
+    group->count = 0;
+    group->memory_ops = 0;
+    group->branch_ops = 0;
+    group->written_regs = 0;
+}
+
+// Point every stage at its group and empty it
+static void iplc_sim_init_pipeline(iplc_sim_t *sim)
+{
+    int i;
+
+    for (i = 0; i < MAX_STAGES; i++) {
+        sim->pipeline[i] = &sim->pipeline_groups[i];
+        iplc_sim_clear_group(sim->pipeline[i]);
+    }
+}
+
+// Returns -1 if the cache won't fit, otherwise 0
+int iplc_sim_init(iplc_sim_t *sim, int index, int blocksize, int assoc)
 {
     int i = 0, j = 0;
-    unsigned long cache_size = 0;
-    cache_index = index;
-    cache_blocksize = blocksize;
-    cache_assoc = assoc;
+    sim->cache_index = index;
+    sim->cache_blocksize = blocksize;
+    sim->cache_assoc = assoc;
 
-    cache_blockoffsetbits = (int) rint( log2( (double) (blocksize * 4) ) );
+    sim->cache_blockoffsetbits = (int) rint( log2( (double) (blocksize * 4) ) );
     /* Note: rint function rounds the result up prior to casting */
+    sim->cache_index_mask = (1u << index) - 1;
+    sim->cache_tag_shift = index + sim->cache_blockoffsetbits;
 
-    cache_size = (unsigned long) (assoc) * (1 << index) * ((32 * blocksize) + 33 - index - cache_blockoffsetbits);
+    sim->cache_size = (unsigned long) (assoc) * (1 << index) * ((32 * blocksize) + 33 - index - sim->cache_blockoffsetbits);
 
-    printf("Cache Configuration \n");
-    printf("   Index: %d bits or %d lines \n", cache_index, (1 << cache_index));
-    printf("   BlockSize: %d \n", cache_blocksize);
-    printf("   Associativity: %d \n", cache_assoc);
-    printf("   BlockOffSetBits: %d \n", cache_blockoffsetbits);
-    printf("   CacheSize: %lu \n", cache_size);
+    // init the pipeline -- every stage starts out empty, even if there's no
+    // cache to go with it, so draining is always safe
+    iplc_sim_init_pipeline(sim);
 
-    if (cache_size > MAX_CACHE_SIZE) {
-        printf("Cache too big. Great than MAX SIZE of %d .... \n", MAX_CACHE_SIZE);
-        exit(-1);
+    if (sim->cache_size > MAX_CACHE_SIZE) {
+        return -1;
     }
 
-    cache = (cache_line_t *) malloc(sizeof(cache_line_t) * (1 << index));
+    sim->cache = (cache_line_t *) malloc(sizeof(cache_line_t) * (1 << index));
 
     // Dynamically create our cache based on the information the user entered
     for (i = 0; i < (1 << index); i++) {
-        cache[i].last_accessed = (byte*) malloc(sizeof(byte) * cache_assoc);
-        cache[i].tag = (int*) malloc(sizeof(int) * cache_assoc);
-        cache[i].valid = (byte*) malloc(sizeof(byte) * cache_assoc);
-        for (j = 0; j < cache_assoc; j ++) {
-            cache[i].last_accessed[j] = 0;
-            cache[i].tag[j] = 0;
-            cache[i].valid[j] = 0;
+        sim->cache[i].last_accessed = (byte*) malloc(sizeof(byte) * sim->cache_assoc);
+        sim->cache[i].tag = (int*) malloc(sizeof(int) * sim->cache_assoc);
+        sim->cache[i].valid = (byte*) malloc(sizeof(byte) * sim->cache_assoc);
+        sim->cache[i].state = (byte*) malloc(sizeof(byte) * sim->cache_assoc);
+        for (j = 0; j < sim->cache_assoc; j ++) {
+            sim->cache[i].last_accessed[j] = 0;
+            sim->cache[i].tag[j] = 0;
+            sim->cache[i].valid[j] = 0;
+            sim->cache[i].state[j] = MESI_INVALID;
         }
     }
+    return 0;
+}
 
-    // init the pipeline -- set all data to zero and instructions to NOP
-    for (i = 0; i < MAX_STAGES; i++) {
-        // itype is set to O which is NOP type instruction
-        memset(&(pipeline[i]), NOP, sizeof(pipeline_t));
+// Returns -1 if the pipeline is wider than we can model, otherwise 0
+int iplc_sim_init_issue(iplc_sim_t *sim, int issue_width, int memory_ports, int branch_units)
+{
+    //Anything left at 0 is the single-issue pipeline we've always had
+    sim->issue_width = issue_width > 0 ? issue_width : 1;
+    sim->memory_ports = memory_ports > 0 ? memory_ports : 1;
+    sim->branch_units = branch_units > 0 ? branch_units : 1;
+
+    return sim->issue_width > IPLC_SIM_MAX_ISSUE_WIDTH ? -1 : 0;
+}
+
+void iplc_sim_print_config(iplc_sim_t *sim)
+{
+    printf("Cache Configuration \n");
+    printf("   Index: %d bits or %d lines \n", sim->cache_index, (1 << sim->cache_index));
+    printf("   BlockSize: %d \n", sim->cache_blocksize);
+    printf("   Associativity: %d \n", sim->cache_assoc);
+    printf("   BlockOffSetBits: %d \n", sim->cache_blockoffsetbits);
+    printf("   CacheSize: %lu \n", sim->cache_size);
+
+    if (sim->cache_size > MAX_CACHE_SIZE) {
+        printf("Cache too big. Great than MAX SIZE of %d .... \n", MAX_CACHE_SIZE);
+    }
+
+    //Single-issue is the default, so only mention anything wider
+    if (sim->issue_width > 1) {
+        printf("Pipeline Configuration \n");
+        printf("   Issue Width: %d \n", sim->issue_width);
+        printf("   Memory Ports: %d \n", sim->memory_ports);
+        printf("   Branch Units: %d \n", sim->branch_units);
+
+        if (sim->issue_width > IPLC_SIM_MAX_ISSUE_WIDTH) {
+            printf("Pipeline too wide. Greater than MAX ISSUE WIDTH of %d .... \n", IPLC_SIM_MAX_ISSUE_WIDTH);
+        }
+    }
+}
+
+void iplc_sim_free_cache(iplc_sim_t *sim)
+{
+    int i;
+
+    if (sim->cache == NULL) {
+        return;
     }
+    for (i = 0; i < (1 << sim->cache_index); i++) {
+        free(sim->cache[i].last_accessed);
+        free(sim->cache[i].tag);
+        free(sim->cache[i].valid);
+        free(sim->cache[i].state);
+    }
+    free(sim->cache);
+    sim->cache = NULL;
 }
 
 /*
  * iplc_sim_trap_address() determined this is not in our cache.  Put it there
  * and make sure that is now our Most Recently Used (MRU) entry.
  */
-void iplc_sim_LRU_replace_on_miss(int index, int tag)
+void iplc_sim_LRU_replace_on_miss(iplc_sim_t *sim, int index, int tag)
 {
-    int lru = cache_line_select_replace(cache[index]);
+    int lru = cache_line_select_replace(sim, sim->cache[index]);
+    int lru_access = sim->cache[index].last_accessed[lru];
     //Set the oldest one to be the greatest
-    cache[index].last_accessed[lru] = cache_assoc;
-    cache[index].tag[lru] = tag;
-    cache[index].valid[lru] = 1;
-
-    //And subtract one from all the rest
-    for (int i = 0; i < cache_assoc; ++i) {
-        cache[index].last_accessed[i] --;
+    sim->cache[index].last_accessed[lru] = sim->cache_assoc;
+    sim->cache[index].tag[lru] = tag;
+    sim->cache[index].valid[lru] = 1;
+
+    //And subtract one from all the ones newer than what we replaced
+    // (all of them, unless another core invalidated a slot out of LRU order)
+    for (int i = 0; i < sim->cache_assoc; ++i) {
+        if (sim->cache[index].last_accessed[i] > lru_access) {
+            sim->cache[index].last_accessed[i] --;
+        }
     }
 	//Means the one we updated will have its access set to assoc - 1
 	//When this hits zero it will be overwritten with new data
@@ -225,65 +403,72 @@ void iplc_sim_LRU_replace_on_miss(int index, int tag)
  * iplc_sim_trap_address() determined the entry is in our cache.  Update its
  * information in the cache.
  */
-void iplc_sim_LRU_update_on_hit(int index, int assoc_entry)
+void iplc_sim_LRU_update_on_hit(iplc_sim_t *sim, int index, int assoc_entry)
 {
-    int hit_access = cache[index].last_accessed[assoc_entry];
+    int hit_access = sim->cache[index].last_accessed[assoc_entry];
     //Mark this one as the most recently accessed
-    cache[index].last_accessed[assoc_entry] = cache_assoc;
-    for (int i = 0; i < cache_assoc; ++i) {
+    sim->cache[index].last_accessed[assoc_entry] = sim->cache_assoc;
+    for (int i = 0; i < sim->cache_assoc; ++i) {
         //Anything that was accessed "after" this one is decremented
         // Eg we hit 1, so change 2 -> 1, 3 -> 2
-        if (cache[index].last_accessed[i] > hit_access) {
-            cache[index].last_accessed[i] --;
+        if (sim->cache[index].last_accessed[i] > hit_access) {
+            sim->cache[index].last_accessed[i] --;
         }
     }
 }
 
 /*
- Given an address and range of bits in the index (start-end, inclusive)
- return the index.  Example:
-
- Given the address below, start of 4, and end of 11
-
-    2    1    3    5    C    6    9    0
- 0010 0001 0011 0101 1100 0110 1001 0000
-                          ^       ^
-                          e       s
-
- this function should return 0110 1001 or 0x69 or 105 in decimal.
+ * Count the access and update LRU for one lookup, whichever way it went.
+ * Both trap_address paths come through here.
  */
-uint32_t get_index(uint32_t address, uint32_t idx_start, uint32_t idx_end)
+static inline int iplc_sim_cache_lookup(iplc_sim_t *sim, int index, int tag)
 {
-    //For lsb=1, msb=4, this gives 00000000011110
-    uint32_t bitMask = (uint32_t)((2 << idx_end) - 1);
-    return (address & bitMask) >> idx_start;
+    //If we didn't miss, we hit
+    int assoc_entry = cache_line_assoc_handler(sim, sim->cache[index], tag);
+    int hit = assoc_entry != -1;
+
+    // Call the appropriate function for a miss or hit
+    sim->cache_access ++;
+    if (hit) {
+        sim->cache_hit ++;
+        iplc_sim_LRU_update_on_hit(sim, index, assoc_entry);
+    } else {
+        sim->cache_miss ++;
+        if (sim->system && cache_line_coherence_lost(sim, sim->cache[index], tag)) {
+            sim->coherence_miss ++;
+        }
+        iplc_sim_LRU_replace_on_miss(sim, index, tag);
+    }
+    return hit;
 }
+
 /*
  * Check if the address is in our cache.  Update our counter statistics
  * for cache_access, cache_hit, etc.  If our configuration supports
  * associativity we may need to check through multiple entries for our
  * desired index.  In that case we will also need to call the LRU functions.
+ * In a multi-core run this is also where we ask for the bus.
  */
-int iplc_sim_trap_address(unsigned int address)
+int iplc_sim_trap_address(iplc_sim_t *sim, unsigned int address, int is_write)
 {
-    int i = 0, index = get_index(address, cache_blockoffsetbits, cache_index + cache_blockoffsetbits - 1);
-    int tag = get_index(address, cache_index + cache_blockoffsetbits, 31);
-    int assoc_entry = cache_line_assoc_handler(cache[index], tag);
-    //If we didn't miss, we hit
-    int hit = assoc_entry != -1;
+    int index = (address >> sim->cache_blockoffsetbits) & sim->cache_index_mask;
+    int tag = address >> sim->cache_tag_shift;
+    int hit;
 
-    printf("Address %x: Tag= %x, Index= %x\n", address, tag, index);
+    IPLC_INSTRUMENT_BEGIN(IPLC_PHASE_CACHE);
+    hit = iplc_sim_cache_lookup(sim, index, tag);
 
-    // Call the appropriate function for a miss or hit
-    cache_access ++;
-    if (hit) {
-        cache_hit ++;
-        iplc_sim_LRU_update_on_hit(index, assoc_entry);
-    } else {
-        cache_miss ++;
-        iplc_sim_LRU_replace_on_miss(index, tag);
+    if (sim->verbose) {
+        IPLC_INSTRUMENT_BEGIN(IPLC_PHASE_OUTPUT);
+        printf("Address %x: Tag= %x, Index= %x\n", address, tag, index);
+        IPLC_INSTRUMENT_END(IPLC_PHASE_OUTPUT);
+    }
+
+    if (sim->system) {
+        iplc_sim_coherence_request(sim, index, tag, hit, is_write);
     }
 
+    IPLC_INSTRUMENT_END(IPLC_PHASE_CACHE);
     /* expects you to return 1 for hit, 0 for miss */
     return hit;
 }
@@ -291,313 +476,862 @@ int iplc_sim_trap_address(unsigned int address)
 /*
  * Just output our summary statistics.
  */
-void iplc_sim_finalize()
+void iplc_sim_finalize(iplc_sim_t *sim)
 {
+    iplc_sim_stats_t stats;
+
     /* Finish processing all instructions in the Pipeline */
-    while (pipeline[FETCH].itype != NOP  ||
-           pipeline[DECODE].itype != NOP ||
-           pipeline[ALU].itype != NOP    ||
-           pipeline[MEM].itype != NOP    ||
-           pipeline[WRITEBACK].itype != NOP) {
-        iplc_sim_push_pipeline_stage();
-    }
+    iplc_sim_drain_pipeline(sim);
 
+    iplc_sim_get_stats(sim, &stats);
+    iplc_sim_print_stats(&stats, sim->system != NULL);
+}
+
+void iplc_sim_print_cache_stats(const iplc_sim_stats_t *stats)
+{
+    IPLC_INSTRUMENT_BEGIN(IPLC_PHASE_OUTPUT);
     printf(" Cache Performance \n");
-    printf("\t Number of Cache Accesses is %ld \n", cache_access);
-    printf("\t Number of Cache Misses is %ld \n", cache_miss);
-    printf("\t Number of Cache Hits is %ld \n", cache_hit);
-    printf("\t Cache Miss Rate is %f \n\n", (double)cache_miss / (double)cache_access);
+    printf("\t Number of Cache Accesses is %ld \n", stats->cache_access);
+    printf("\t Number of Cache Misses is %ld \n", stats->cache_miss);
+    printf("\t Number of Cache Hits is %ld \n", stats->cache_hit);
+    printf("\t Cache Miss Rate is %f \n\n", (double)stats->cache_miss / (double)stats->cache_access);
+    IPLC_INSTRUMENT_END(IPLC_PHASE_OUTPUT);
+}
+
+void iplc_sim_print_stats(const iplc_sim_stats_t *stats, int coherence)
+{
+    IPLC_INSTRUMENT_BEGIN(IPLC_PHASE_OUTPUT);
+    iplc_sim_print_cache_stats(stats);
     printf("Pipeline Performance \n");
-    printf("\t Total Cycles is %u \n", pipeline_cycles);
-    printf("\t Total Instructions is %u \n", instruction_count);
-    printf("\t Total Branch Instructions is %u \n", branch_count);
-    printf("\t Total Correct Branch Predictions is %u \n", correct_branch_predictions);
-    printf("\t CPI is %f \n\n", (double)pipeline_cycles / (double)instruction_count);
+    printf("\t Total Cycles is %u \n", stats->pipeline_cycles);
+    printf("\t Total Instructions is %u \n", stats->instruction_count);
+    printf("\t Total Branch Instructions is %u \n", stats->branch_count);
+    printf("\t Total Correct Branch Predictions is %u \n", stats->correct_branch_predictions);
+    printf("\t CPI is %f \n\n", (double)stats->pipeline_cycles / (double)stats->instruction_count);
+
+    if (stats->issue_width > 1) {
+        int i;
+        printf("Issue Utilization \n");
+        for (i = 0; i <= stats->issue_width; i++) {
+            printf("\t Cycles Issuing %d is %u (%f) \n", i, stats->issue_cycles[i],
+                   (double)stats->issue_cycles[i] / (double)stats->pipeline_cycles);
+        }
+        printf("\t IPC is %f \n\n", (double)stats->instruction_count / (double)stats->pipeline_cycles);
+    }
+
+    if (coherence) {
+        printf("Coherence Performance \n");
+        printf("\t Number of Coherence Misses is %ld \n", stats->coherence_miss);
+        printf("\t Number of Invalidations Sent is %ld \n", stats->coherence_invalidations);
+        printf("\t Number of Cache-to-Cache Transfers is %ld \n\n", stats->coherence_transfers);
+    }
+    IPLC_INSTRUMENT_END(IPLC_PHASE_OUTPUT);
+}
+
+/************************************************************************************************/
+/* Coherence Functions **************************************************************************/
+/************************************************************************************************/
+
+/*
+ * MESI over a snooping bus, resolved a quantum at a time.  While a quantum
+ * runs, each core only ever touches its own cache: anything that would go
+ * out on the bus is written to the core's bus log instead, and our copy is
+ * marked as requested.  At the end of the quantum
+ * iplc_sim_coherence_resolve() plays every core's log onto the other caches
+ * in cycle order.  No core sees another's traffic until then, but no locks
+ * are needed and every run gives the same results.
+ */
+void iplc_sim_coherence_request(iplc_sim_t *sim, int index, int tag, int hit, int is_write)
+{
+    int slot = cache_line_assoc_handler(sim, sim->cache[index], tag);
+    byte *state = &sim->cache[index].state[slot];
+    bus_transaction_t *transaction;
+
+    //Reads that hit, and writes to a block we already own (or will), stay
+    // off the bus
+    if (hit && (!is_write || *state == MESI_MODIFIED || *state == MESI_REQUESTED_WRITE)) {
+        return;
+    }
+    //Nobody else has a copy, so we can write it silently
+    if (hit && *state == MESI_EXCLUSIVE) {
+        *state = MESI_MODIFIED;
+        return;
+    }
+
+    //Either a miss (BusRd / BusRdX) or a write to a shared block (BusUpgr)
+    if (sim->bus_log_count == sim->bus_log_size) {
+        sim->bus_log_size = sim->bus_log_size ? sim->bus_log_size * 2 : 256;
+        sim->bus_log = (bus_transaction_t *) realloc(sim->bus_log, sizeof(bus_transaction_t) * sim->bus_log_size);
+    }
+    transaction = &sim->bus_log[sim->bus_log_count++];
+    transaction->cycle = sim->pipeline_cycles;
+    transaction->index = index;
+    transaction->tag = tag;
+    transaction->is_write = is_write;
+
+    *state = is_write ? MESI_REQUESTED_WRITE : MESI_REQUESTED_READ;
+}
+
+/*
+ * One transaction from sim's bus log, seen by every other core.  Bus time is
+ * added to coherence_delay and charged the next time sim's pipeline advances.
+ */
+static void iplc_sim_coherence_snoop(iplc_sim_t *sim, const bus_transaction_t *transaction)
+{
+    iplc_sim_system_t *system = sim->system;
+    int index = transaction->index;
+    int tag = transaction->tag;
+    int i, other, slot;
+    int shared = 0, invalidated = 0;
+
+    for (i = 0; i < system->core_count; i++) {
+        iplc_sim_t *core = system->cores[i];
+        if (core == sim) continue;
+
+        other = cache_line_assoc_handler(core, core->cache[index], tag);
+        if (other == -1) continue;
+        //They only got it after us this quantum, and will snoop us in turn
+        if (core->cache[index].state[other] == MESI_REQUESTED_READ ||
+            core->cache[index].state[other] == MESI_REQUESTED_WRITE) continue;
+
+        //The owner has the only good copy, so it supplies the block
+        if (core->cache[index].state[other] == MESI_MODIFIED) {
+            sim->coherence_delay += COHERENCE_TRANSFER_DELAY;
+            sim->coherence_transfers ++;
+        }
+
+        if (transaction->is_write) {
+            core->cache[index].valid[other] = 0;
+            core->cache[index].state[other] = MESI_STALE;
+            sim->coherence_invalidations ++;
+            invalidated = 1;
+        } else {
+            core->cache[index].state[other] = MESI_SHARED;
+            shared = 1;
+        }
+    }
+
+    //One invalidate goes out on the bus no matter how many copies it kills
+    if (invalidated) {
+        sim->coherence_delay += COHERENCE_INVALIDATE_DELAY;
+    }
+
+    //Our copy may have been replaced (or invalidated) since we asked for it
+    slot = cache_line_assoc_handler(sim, sim->cache[index], tag);
+    if (slot == -1) {
+        return;
+    }
+    if (transaction->is_write) {
+        sim->cache[index].state[slot] = MESI_MODIFIED;
+    } else {
+        sim->cache[index].state[slot] = shared ? MESI_SHARED : MESI_EXCLUSIVE;
+    }
+}
+
+/*
+ * Put every core's bus log for the quantum on the bus, oldest cycle first,
+ * and the lowest core first when two cores asked in the same cycle.  Only
+ * called while all the cores are waiting at the barrier.
+ */
+static void iplc_sim_coherence_resolve(iplc_sim_system_t *system)
+{
+    int next[MAX_CORES];
+    int i, first;
+
+    memset(next, 0, sizeof(next));
+    while (1) {
+        first = -1;
+        for (i = 0; i < system->core_count; i++) {
+            iplc_sim_t *core = system->cores[i];
+            if (next[i] == core->bus_log_count) continue;
+            if (first == -1 ||
+                core->bus_log[next[i]].cycle < system->cores[first]->bus_log[next[first]].cycle) {
+                first = i;
+            }
+        }
+        if (first == -1) {
+            break;
+        }
+        iplc_sim_coherence_snoop(system->cores[first], &system->cores[first]->bus_log[next[first]]);
+        next[first]++;
+    }
+
+    for (i = 0; i < system->core_count; i++) {
+        system->cores[i]->bus_log_count = 0;
+    }
 }
 
 /************************************************************************************************/
 /* Pipeline Functions ***************************************************************************/
 /************************************************************************************************/
 
+// Print one stage's instructions for iplc_sim_dump_pipeline()
+static void iplc_sim_dump_group(pipeline_group_t *group)
+{
+    int i;
+
+    //An empty stage shows up as a NOP at address 0, like it always has
+    if (group->count == 0) {
+        printf("%d: 0x%x ", NOP, 0);
+    }
+    for (i = 0; i < group->count; i++) {
+        printf("%d: 0x%x ", group->slot[i].itype, group->slot[i].instruction_address);
+    }
+}
+
 /*
  * Dump the current contents of our pipeline.
  */
-void iplc_sim_dump_pipeline()
+int iplc_sim_dump_pipeline(iplc_sim_t *sim)
 {
     int i;
 
+    IPLC_INSTRUMENT_BEGIN(IPLC_PHASE_OUTPUT);
     for (i = 0; i < MAX_STAGES; i++) {
         switch(i) {
             case FETCH:
-                printf("(cyc: %u) FETCH:\t %d: 0x%x \t", pipeline_cycles, pipeline[i].itype, pipeline[i].instruction_address);
+                printf("(cyc: %u) FETCH:\t ", sim->pipeline_cycles);
+                iplc_sim_dump_group(sim->pipeline[i]);
+                printf("\t");
                 break;
             case DECODE:
-                printf("DECODE:\t %d: 0x%x \t", pipeline[i].itype, pipeline[i].instruction_address);
+                printf("DECODE:\t ");
+                iplc_sim_dump_group(sim->pipeline[i]);
+                printf("\t");
                 break;
             case ALU:
-                printf("ALU:\t %d: 0x%x \t", pipeline[i].itype, pipeline[i].instruction_address);
+                printf("ALU:\t ");
+                iplc_sim_dump_group(sim->pipeline[i]);
+                printf("\t");
                 break;
             case MEM:
-                printf("MEM:\t %d: 0x%x \t", pipeline[i].itype, pipeline[i].instruction_address);
+                printf("MEM:\t ");
+                iplc_sim_dump_group(sim->pipeline[i]);
+                printf("\t");
                 break;
             case WRITEBACK:
-                printf("WB:\t %d: 0x%x \n", pipeline[i].itype, pipeline[i].instruction_address);
+                printf("WB:\t ");
+                iplc_sim_dump_group(sim->pipeline[i]);
+                printf("\n");
                 break;
             default:
                 printf("DUMP: Bad stage!\n");
-                exit(-1);
+                IPLC_INSTRUMENT_END(IPLC_PHASE_OUTPUT);
+                return -1;
         }
     }
+    IPLC_INSTRUMENT_END(IPLC_PHASE_OUTPUT);
+    return 0;
+}
+
+// One bit per register; anything that isn't a register gets no bit
+static unsigned int iplc_sim_register_bit(int reg)
+{
+    return (reg >= 0 && reg < 32) ? 1u << reg : 0;
+}
+
+/*
+ * Returns 1 if the stage reads or writes reg.  This is the check for whether
+ * an instruction in ALU has to wait on the one in MEM.
+ */
+static int iplc_sim_stage_uses_register(const pipeline_t *stage, int reg)
+{
+    switch (stage->itype) {
+        case RTYPE:
+            return stage->stage.rtype.reg1 == reg ||
+                   stage->stage.rtype.reg2_or_constant == reg ||
+                   stage->stage.rtype.dest_reg == reg;
+        case LW:
+            return stage->stage.lw.dest_reg == reg ||
+                   stage->stage.lw.base_reg == reg;
+        case SW:
+            return stage->stage.sw.base_reg == reg ||
+                   stage->stage.sw.src_reg == reg;
+        case BRANCH:
+            return stage->stage.branch.reg1 == reg ||
+                   stage->stage.branch.reg2 == reg;
+        case NOP:
+        case JUMP:
+        case JAL:
+        case SYSCALL:
+            break;
+    }
+    return 0;
+}
+
+// Registers the stage reads and writes, as iplc_sim_register_bit() masks
+static void iplc_sim_stage_registers(const pipeline_t *stage, unsigned int *reads, unsigned int *writes)
+{
+    *reads = 0;
+    *writes = 0;
+    switch (stage->itype) {
+        case RTYPE:
+            *reads = iplc_sim_register_bit(stage->stage.rtype.reg1) |
+                     iplc_sim_register_bit(stage->stage.rtype.reg2_or_constant);
+            *writes = iplc_sim_register_bit(stage->stage.rtype.dest_reg);
+            break;
+        case LW:
+            *reads = iplc_sim_register_bit(stage->stage.lw.base_reg);
+            *writes = iplc_sim_register_bit(stage->stage.lw.dest_reg);
+            break;
+        case SW:
+            *reads = iplc_sim_register_bit(stage->stage.sw.base_reg) |
+                     iplc_sim_register_bit(stage->stage.sw.src_reg);
+            break;
+        case BRANCH:
+            *reads = iplc_sim_register_bit(stage->stage.branch.reg1) |
+                     iplc_sim_register_bit(stage->stage.branch.reg2);
+            break;
+        case NOP:
+        case JUMP:
+        case JAL:
+        case SYSCALL:
+            break;
+    }
 }
 
 /*
  * Check if various stages of our pipeline require stalls, forwarding, etc.
  * Then push the contents of our various pipeline stages through the pipeline.
+ * Every stage is a group of instructions (just one when single-issue), and
+ * the checks below go over each instruction in it.
  */
-void iplc_sim_push_pipeline_stage()
+void iplc_sim_push_pipeline_stage(iplc_sim_t *sim)
 {
-    int i;
-    int data_hit = 1;
+    pipeline_group_t **pipeline = sim->pipeline;
+    pipeline_group_t *empty;
+    unsigned int start_cycles = sim->pipeline_cycles;
+    int mispredictions = 0;
+    int miss_delay = 0;
+    int data_hazard = 0;
+    int issued;
+    int i, j;
 
     /* 1. Count WRITEBACK stage is "retired" -- This I'm giving you */
-    if (pipeline[WRITEBACK].instruction_address) {
-        instruction_count++;
+    for (i = 0; i < pipeline[WRITEBACK]->count; i++) {
+        if (pipeline[WRITEBACK]->slot[i].instruction_address) {
+            sim->instruction_count++;
 #ifdef DEBUG
+            IPLC_INSTRUMENT_BEGIN(IPLC_PHASE_OUTPUT);
             printf("DEBUG: Retired Instruction at 0x%x, Type %d, at Time %u \n",
-                   pipeline[WRITEBACK].instruction_address, pipeline[WRITEBACK].itype, pipeline_cycles);
+                   pipeline[WRITEBACK]->slot[i].instruction_address, pipeline[WRITEBACK]->slot[i].itype, sim->pipeline_cycles);
+            IPLC_INSTRUMENT_END(IPLC_PHASE_OUTPUT);
 #endif
+        }
     }
 
     /* 2. Check for BRANCH and correct/incorrect Branch Prediction */
-    if (pipeline[DECODE].itype == BRANCH) {
-        branch_count ++;
+    for (i = 0; i < pipeline[DECODE]->count; i++) {
+        pipeline_t *branch = &pipeline[DECODE]->slot[i];
+        pipeline_t *next = NULL;
+
+        if (branch->itype != BRANCH) {
+            continue;
+        }
+        sim->branch_count ++;
         int branch_taken = 1;
-	    //Check for branching-- if the next address (in FETCH stage) is 4 greater
-	    // than our current address, we didn't take the branch.
-        if (pipeline[DECODE].instruction_address + 4 == pipeline[FETCH].instruction_address) {
+        //The instruction after the branch is either next in its group or the
+        // first one being fetched
+        if (i + 1 < pipeline[DECODE]->count) {
+            next = &pipeline[DECODE]->slot[i + 1];
+        } else if (pipeline[FETCH]->count > 0) {
+            next = &pipeline[FETCH]->slot[0];
+        }
+	    //Check for branching-- if the next address is 4 greater than our
+	    // current address, we didn't take the branch.
+        if (next && branch->instruction_address + 4 == next->instruction_address) {
             branch_taken = 0;
         }
 
 	    //Check for prediction failure/success, only if we actually have a stage
-        if (pipeline[FETCH].instruction_address) {
-            if (branch_taken == branch_predict_taken) {
-                correct_branch_predictions++;
-                if (branch_taken) {
+        if (next && next->instruction_address) {
+            if (branch_taken == sim->branch_predict_taken) {
+                sim->correct_branch_predictions++;
+                if (branch_taken && sim->verbose) {
+                    IPLC_INSTRUMENT_BEGIN(IPLC_PHASE_OUTPUT);
                     printf("DEBUG: Branch Taken: FETCH addr = 0x%x, DECODE instr addr = 0x%x\n",
-                           pipeline[FETCH].instruction_address,
-                           pipeline[DECODE].instruction_address);
+                           next->instruction_address,
+                           branch->instruction_address);
+                    IPLC_INSTRUMENT_END(IPLC_PHASE_OUTPUT);
                 }
             } else {
-	            //Need to waste a cycle as a penalty
-                pipeline_cycles++;
-                pipeline[WRITEBACK] = pipeline[MEM];
-                pipeline[MEM] = pipeline[ALU];
-                pipeline[ALU] = pipeline[DECODE];
-	            //And if anything would have hit WRITEBACK we've popped it off so add
-	            // an instruction to the counter
-                if (pipeline[WRITEBACK].instruction_address) {
-                    instruction_count++;
-                }
-                //And this stage is cleared
-                memset(&(pipeline[DECODE]), NOP, sizeof(pipeline_t));
+                mispredictions++;
             }
         }
     }
+    //Issued instructions this cycle, unless a misprediction issues them early
+    issued = pipeline[DECODE]->count;
+    if (mispredictions) {
+	    //Need to waste a cycle as a penalty (for each branch we got wrong)
+        sim->pipeline_cycles += mispredictions;
+        empty = pipeline[WRITEBACK];
+        pipeline[WRITEBACK] = pipeline[MEM];
+        pipeline[MEM] = pipeline[ALU];
+        pipeline[ALU] = pipeline[DECODE];
+	    //And if anything would have hit WRITEBACK we've popped it off so add
+	    // an instruction to the counter
+        for (i = 0; i < pipeline[WRITEBACK]->count; i++) {
+            if (pipeline[WRITEBACK]->slot[i].instruction_address) {
+                sim->instruction_count++;
+            }
+        }
+        //And this stage is cleared
+        pipeline[DECODE] = empty;
+        iplc_sim_clear_group(pipeline[DECODE]);
+    }
 
-    /* 3. Check for LW delays due to use in ALU stage and if data hit/miss
-     *    add delay cycles if needed.
+    /* 3. Check for LW and SW mem accesses and data hit/miss, and for LW/SW
+     *    delays due to use in ALU stage.  Add delay cycles if needed.  Each
+     *    access has its own memory port, but the cache only handles one miss
+     *    at a time, and one stall covers any number of hazards.
      */
-    if (pipeline[MEM].itype == LW) {
+    for (i = 0; i < pipeline[MEM]->count; i++) {
+        pipeline_t *mem = &pipeline[MEM]->slot[i];
+        unsigned int data_address;
+        int our_register;
         int hit;
-	    //Register that we're using, check if it's going to be used anywhere else
-        int our_register = pipeline[MEM].stage.lw.base_reg;
-        int data_hazard = 0;
 
-        hit = iplc_sim_trap_address(pipeline[MEM].stage.lw.data_address);
-        if (hit) {
-            printf("DATA HIT:\t Address 0x%x\n", pipeline[MEM].stage.sw.data_address);
+        if (mem->itype == LW) {
+	        //Register that we're using, check if it's going to be used anywhere else
+            our_register = mem->stage.lw.base_reg;
+            data_address = mem->stage.lw.data_address;
+        } else if (mem->itype == SW) {
+            our_register = mem->stage.sw.src_reg;
+            data_address = mem->stage.sw.data_address;
+        } else {
+            continue;
+        }
 
-	        //Check if we have a data hazard, if that's the case then we need to wait a cycle
-            switch (pipeline[ALU].itype) {
-                case RTYPE:
-                    if (pipeline[ALU].stage.rtype.reg1 == our_register ||
-                        pipeline[ALU].stage.rtype.reg2_or_constant == our_register ||
-                        pipeline[ALU].stage.rtype.dest_reg == our_register)
-                            data_hazard = 1;
-                    break;
-                case LW:
-                    if (pipeline[ALU].stage.lw.dest_reg == our_register ||
-                        pipeline[ALU].stage.lw.base_reg == our_register)
-                            data_hazard = 1;
-                    break;
-                case SW:
-                    if (pipeline[ALU].stage.sw.base_reg == our_register ||
-                        pipeline[ALU].stage.sw.src_reg == our_register)
-                            data_hazard = 1;
-                    break;
-                case BRANCH:
-                    if (pipeline[ALU].stage.branch.reg1 == our_register ||
-                        pipeline[ALU].stage.branch.reg2 == our_register)
-                            data_hazard = 1;
-                    break;
-                case NOP:
-                case JUMP:
-                case JAL:
-                case SYSCALL:
-                    break;
+        hit = iplc_sim_trap_address(sim, data_address, mem->itype == SW);
+        if (hit) {
+            if (sim->verbose) {
+                IPLC_INSTRUMENT_BEGIN(IPLC_PHASE_OUTPUT);
+                printf("DATA HIT:\t Address 0x%x\n", data_address);
+                IPLC_INSTRUMENT_END(IPLC_PHASE_OUTPUT);
             }
 
-            if (data_hazard == 1) {
-	            //Yep, hazard. Wait for it to be free.
-                pipeline_cycles ++;
+	        //Check if we have a data hazard, if that's the case then we need to wait a cycle
+            for (j = 0; j < pipeline[ALU]->count; j++) {
+                if (iplc_sim_stage_uses_register(&pipeline[ALU]->slot[j], our_register)) {
+                    data_hazard = 1;
+                }
             }
         } else {
 	        //Data miss-- need to add a penalty number of cycles to wait for stuff to load
-            printf("DATA MISS:\t Address 0x%x\n", pipeline[MEM].stage.sw.data_address);
-            pipeline_cycles += CACHE_MISS_DELAY - 1;
+            if (sim->verbose) {
+                IPLC_INSTRUMENT_BEGIN(IPLC_PHASE_OUTPUT);
+                printf("DATA MISS:\t Address 0x%x\n", data_address);
+                IPLC_INSTRUMENT_END(IPLC_PHASE_OUTPUT);
+            }
+            miss_delay += CACHE_MISS_DELAY - 1;
         }
     }
+    if (miss_delay) {
+        sim->pipeline_cycles += miss_delay;
+    } else if (data_hazard) {
+	    //Yep, hazard. Wait for it to be free.
+        sim->pipeline_cycles ++;
+    }
 
-    /* 4. Check for SW mem access and data miss .. add delay cycles if needed */
-    if (pipeline[MEM].itype == SW) {
-        int hit;
-	    //Register that we're using, check if it's going to be used anywhere else
-        int our_register = pipeline[MEM].stage.sw.src_reg;
-        int data_hazard = 0;
+    /* 4. Increment pipe_cycles 1 cycle for normal processing, plus whatever
+     *    the bus cost us (invalidates and transfers) since the last push */
+    sim->pipeline_cycles ++;
+    sim->pipeline_cycles += sim->coherence_delay;
+    sim->coherence_delay = 0;
 
-        hit = iplc_sim_trap_address(pipeline[MEM].stage.sw.data_address);
-        if (hit) {
-            printf("DATA HIT:\t Address 0x%x\n", pipeline[MEM].stage.sw.data_address);
+    /* 5. push stages thru MEM->WB, ALU->MEM, DECODE->ALU, FETCH->DECODE */
+    empty = pipeline[WRITEBACK];
+    pipeline[WRITEBACK] = pipeline[MEM];
+    pipeline[MEM] = pipeline[ALU];
+    pipeline[ALU] = pipeline[DECODE];
+    pipeline[DECODE] = pipeline[FETCH];
 
-	        //Check if we have a data hazard, if that's the case then we need to wait a cycle
-            switch (pipeline[ALU].itype) {
-                case RTYPE:
-                    if (pipeline[ALU].stage.rtype.reg1 == our_register ||
-                        pipeline[ALU].stage.rtype.reg2_or_constant == our_register ||
-                        pipeline[ALU].stage.rtype.dest_reg == our_register) {
-                        data_hazard = 1;
-                    }
-                    break;
-                case LW:
-                    if (pipeline[ALU].stage.lw.dest_reg == our_register ||
-                        pipeline[ALU].stage.lw.base_reg == our_register) {
-                        data_hazard = 1;
-                    }
-                    break;
-                case SW:
-                    if (pipeline[ALU].stage.sw.base_reg == our_register ||
-                        pipeline[ALU].stage.sw.src_reg == our_register) {
-                        data_hazard = 1;
-                    }
-                    break;
-                case BRANCH:
-                    if (pipeline[ALU].stage.branch.reg1 == our_register ||
-                        pipeline[ALU].stage.branch.reg2 == our_register) {
-                        data_hazard = 1;
-                    }
-                    break;
-                case NOP:
-                case JUMP:
-                case JAL:
-                case SYSCALL:
-                    break;
-            }
+    // 6. This is a give'me -- Reset the FETCH stage to empty */
+    pipeline[FETCH] = empty;
+    iplc_sim_clear_group(pipeline[FETCH]);
+
+    /* 7. One of the cycles we just spent issued whatever went into ALU, and
+     *    every other one (stalls and penalties) issued nothing */
+    sim->issue_cycles[issued]++;
+    sim->issue_cycles[0] += sim->pipeline_cycles - start_cycles - 1;
+}
 
-            if (data_hazard == 1) {
-	            //Yep, hazard. Wait for it to be free.
-                pipeline_cycles ++;
+/*
+ * Keep pushing until every stage of the pipeline is empty.
+ */
+int iplc_sim_pipeline_busy(iplc_sim_t *sim)
+{
+    int i, j;
+
+    for (i = 0; i < MAX_STAGES; i++) {
+        for (j = 0; j < sim->pipeline[i]->count; j++) {
+            if (sim->pipeline[i]->slot[j].itype != NOP) {
+                return 1;
             }
-        } else {
-	        //Data miss-- need to add a penalty number of cycles to wait for stuff to write
-            printf("DATA MISS:\t Address 0x%x\n", pipeline[MEM].stage.sw.data_address);
-            pipeline_cycles += CACHE_MISS_DELAY - 1;
         }
     }
+    return 0;
+}
 
-    /* 5. Increment pipe_cycles 1 cycle for normal processing */
-    pipeline_cycles ++;
+void iplc_sim_drain_pipeline(iplc_sim_t *sim)
+{
+    IPLC_INSTRUMENT_BEGIN(IPLC_PHASE_PIPELINE);
+    if (sim->cache_only) {
+        iplc_sim_drain_cache_only(sim);
+    } else {
+        while (iplc_sim_pipeline_busy(sim)) {
+            iplc_sim_push_pipeline_stage(sim);
+        }
+    }
+    IPLC_INSTRUMENT_END(IPLC_PHASE_PIPELINE);
+}
 
-    /* 6. push stages thru MEM->WB, ALU->MEM, DECODE->ALU, FETCH->DECODE */
-    pipeline[WRITEBACK] = pipeline[MEM];
-    pipeline[MEM] = pipeline[ALU];
-    pipeline[ALU] = pipeline[DECODE];
-    pipeline[DECODE] = pipeline[FETCH];
+/*
+ * Returns 1 if the instruction can be fetched in the same cycle as what is
+ * already in FETCH.  That needs room in the group, the next address along
+ * (a fetch reads one run of memory), a free memory port or branch unit if it
+ * needs one, and nothing in the group that it depends on.  A syscall always
+ * goes on its own.
+ */
+static int iplc_sim_can_join_group(iplc_sim_t *sim, const pipeline_t *instruction)
+{
+    pipeline_group_t *fetch = sim->pipeline[FETCH];
+    unsigned int reads, writes;
+
+    if (fetch->count == 0 || fetch->count >= sim->issue_width) {
+        return 0;
+    }
+    if (instruction->instruction_address != fetch->slot[fetch->count - 1].instruction_address + 4) {
+        return 0;
+    }
+
+    switch (instruction->itype) {
+        case LW:
+        case SW:
+            if (fetch->memory_ops >= sim->memory_ports) return 0;
+            break;
+        case BRANCH:
+        case JUMP:
+        case JAL:
+            if (fetch->branch_ops >= sim->branch_units) return 0;
+            break;
+        case SYSCALL:
+            return 0;
+        case NOP:
+        case RTYPE:
+            break;
+    }
+    if (fetch->slot[fetch->count - 1].itype == SYSCALL) {
+        return 0;
+    }
+
+    //Can't read or rewrite a register written by the same group
+    iplc_sim_stage_registers(instruction, &reads, &writes);
+    return ((reads | writes) & fetch->written_regs) == 0;
+}
+
+/*
+ * Put a newly fetched instruction into FETCH.  Single-issue, that always
+ * means pushing the pipeline along first; wider, the instruction joins the
+ * group already being fetched whenever it can.
+ */
+static void iplc_sim_enter_pipeline(iplc_sim_t *sim, const pipeline_t *instruction)
+{
+    pipeline_group_t *fetch;
+    unsigned int reads, writes;
+
+    if (!iplc_sim_can_join_group(sim, instruction)) {
+        iplc_sim_push_pipeline_stage(sim);
+    }
 
-    // 7. This is a give'me -- Reset the FETCH stage to NOP via memset */
-    memset(&(pipeline[FETCH]), NOP, sizeof(pipeline_t));
+    fetch = sim->pipeline[FETCH];
+    fetch->slot[fetch->count++] = *instruction;
+
+    if (instruction->itype == LW || instruction->itype == SW) {
+        fetch->memory_ops++;
+    } else if (instruction->itype == BRANCH || instruction->itype == JUMP || instruction->itype == JAL) {
+        fetch->branch_ops++;
+    }
+    iplc_sim_stage_registers(instruction, &reads, &writes);
+    fetch->written_regs |= writes;
 }
 
 /*
  * This function is fully implemented.  You should use this as a reference
  * for implementing the remaining instruction types.
  */
-void iplc_sim_process_pipeline_rtype(char *instruction, int dest_reg, int reg1, int reg2_or_constant)
+void iplc_sim_process_pipeline_rtype(iplc_sim_t *sim, char *instruction, int dest_reg, int reg1, int reg2_or_constant)
 {
     /* This is an example of what you need to do for the rest */
-    iplc_sim_push_pipeline_stage();
+    pipeline_t fetch;
 
-    pipeline[FETCH].itype = RTYPE;
-    pipeline[FETCH].instruction_address = instruction_address;
+    fetch.itype = RTYPE;
+    fetch.instruction_address = sim->instruction_address;
 
-    strcpy(pipeline[FETCH].stage.rtype.instruction, instruction);
-    pipeline[FETCH].stage.rtype.reg1 = reg1;
-    pipeline[FETCH].stage.rtype.reg2_or_constant = reg2_or_constant;
-    pipeline[FETCH].stage.rtype.dest_reg = dest_reg;
+    strcpy(fetch.stage.rtype.instruction, instruction);
+    fetch.stage.rtype.reg1 = reg1;
+    fetch.stage.rtype.reg2_or_constant = reg2_or_constant;
+    fetch.stage.rtype.dest_reg = dest_reg;
+
+    iplc_sim_enter_pipeline(sim, &fetch);
 }
 
-void iplc_sim_process_pipeline_lw(int dest_reg, int base_reg, unsigned int data_address)
+void iplc_sim_process_pipeline_lw(iplc_sim_t *sim, int dest_reg, int base_reg, unsigned int data_address)
 {
-    iplc_sim_push_pipeline_stage();
-    pipeline[FETCH].itype = LW;
-    pipeline[FETCH].instruction_address = instruction_address;
+    pipeline_t fetch;
+
+    fetch.itype = LW;
+    fetch.instruction_address = sim->instruction_address;
 
-    pipeline[FETCH].stage.lw.base_reg = base_reg;
-    pipeline[FETCH].stage.lw.dest_reg = dest_reg;
-    pipeline[FETCH].stage.lw.data_address = data_address;
+    fetch.stage.lw.base_reg = base_reg;
+    fetch.stage.lw.dest_reg = dest_reg;
+    fetch.stage.lw.data_address = data_address;
+
+    iplc_sim_enter_pipeline(sim, &fetch);
 }
 
-void iplc_sim_process_pipeline_sw(int src_reg, int base_reg, unsigned int data_address)
+void iplc_sim_process_pipeline_sw(iplc_sim_t *sim, int src_reg, int base_reg, unsigned int data_address)
 {
-    iplc_sim_push_pipeline_stage();
-    pipeline[FETCH].itype = SW;
-    pipeline[FETCH].instruction_address = instruction_address;
+    pipeline_t fetch;
+
+    fetch.itype = SW;
+    fetch.instruction_address = sim->instruction_address;
+
+    fetch.stage.sw.base_reg = base_reg;
+    fetch.stage.sw.src_reg = src_reg;
+    fetch.stage.sw.data_address = data_address;
 
-    pipeline[FETCH].stage.sw.base_reg = base_reg;
-    pipeline[FETCH].stage.sw.src_reg = src_reg;
-    pipeline[FETCH].stage.sw.data_address = data_address;
+    iplc_sim_enter_pipeline(sim, &fetch);
 }
 
-void iplc_sim_process_pipeline_branch(int reg1, int reg2)
+void iplc_sim_process_pipeline_branch(iplc_sim_t *sim, int reg1, int reg2)
 {
-    iplc_sim_push_pipeline_stage();
-    pipeline[FETCH].itype = BRANCH;
-    pipeline[FETCH].instruction_address = instruction_address;
+    pipeline_t fetch;
 
-    pipeline[FETCH].stage.branch.reg1 = reg1;
-    pipeline[FETCH].stage.branch.reg2 = reg2;
+    fetch.itype = BRANCH;
+    fetch.instruction_address = sim->instruction_address;
+
+    fetch.stage.branch.reg1 = reg1;
+    fetch.stage.branch.reg2 = reg2;
+
+    iplc_sim_enter_pipeline(sim, &fetch);
+}
+
+void iplc_sim_process_pipeline_jump(iplc_sim_t *sim, char *instruction)
+{
+    pipeline_t fetch;
+
+    fetch.itype = JUMP;
+    fetch.instruction_address = sim->instruction_address;
+
+    strcpy(fetch.stage.jump.instruction, instruction);
+
+    iplc_sim_enter_pipeline(sim, &fetch);
 }
 
-void iplc_sim_process_pipeline_jump(char *instruction)
+void iplc_sim_process_pipeline_syscall(iplc_sim_t *sim)
 {
-    iplc_sim_push_pipeline_stage();
-    pipeline[FETCH].itype = JUMP;
-    pipeline[FETCH].instruction_address = instruction_address;
+    pipeline_t fetch;
+
+    memset(&fetch, 0, sizeof(pipeline_t));
+    fetch.itype = SYSCALL;
+    fetch.instruction_address = sim->instruction_address;
 
-    strcpy(pipeline[FETCH].stage.jump.instruction, instruction);
+    iplc_sim_enter_pipeline(sim, &fetch);
 }
 
-void iplc_sim_process_pipeline_syscall()
+void iplc_sim_process_pipeline_nop(iplc_sim_t *sim)
 {
-    iplc_sim_push_pipeline_stage();
-    pipeline[FETCH].itype = SYSCALL;
-    pipeline[FETCH].instruction_address = instruction_address;
+    pipeline_t fetch;
+
+    memset(&fetch, 0, sizeof(pipeline_t));
+    fetch.itype = NOP;
+    fetch.instruction_address = sim->instruction_address;
+
+    iplc_sim_enter_pipeline(sim, &fetch);
 }
 
-void iplc_sim_process_pipeline_nop()
+/*
+ * Bring the instruction in through the cache.  On a miss the pipeline keeps
+ * moving (with nothing new entering it) while we wait for the block.
+ */
+void iplc_sim_fetch_instruction(iplc_sim_t *sim, unsigned int instruction_address)
 {
-    iplc_sim_push_pipeline_stage();
-    pipeline[FETCH].itype = NOP;
-    pipeline[FETCH].instruction_address = instruction_address;
+    int instruction_hit = 0;
+    int i = 0, j = 0;
+
+    sim->instruction_address = instruction_address;
+    instruction_hit = iplc_sim_trap_address(sim, instruction_address, 0);
+
+    // if a MISS, then push current instruction thru pipeline
+    if (!instruction_hit) {
+        // need to subtract 1, since the stage is pushed once more for actual instruction processing
+        // also need to allow for a branch miss prediction during the fetch cache miss time -- by
+        // counting cycles this allows for these cycles to overlap and not doubly count.
+
+        if (sim->verbose) {
+            IPLC_INSTRUMENT_BEGIN(IPLC_PHASE_OUTPUT);
+            printf("INST MISS:\t Address 0x%x \n", instruction_address);
+            IPLC_INSTRUMENT_END(IPLC_PHASE_OUTPUT);
+        }
+
+        for (i = sim->pipeline_cycles, j = sim->pipeline_cycles; i < j + CACHE_MISS_DELAY - 1; i++)
+            iplc_sim_push_pipeline_stage(sim);
+    } else if (sim->verbose) {
+        IPLC_INSTRUMENT_BEGIN(IPLC_PHASE_OUTPUT);
+        printf("INST HIT:\t Address 0x%x \n", instruction_address);
+        IPLC_INSTRUMENT_END(IPLC_PHASE_OUTPUT);
+    }
+}
+
+// Is this a type we know how to send down the pipeline?
+static int iplc_sim_record_valid(const iplc_sim_record_t *record)
+{
+    return record->type >= IPLC_SIM_NOP && record->type <= IPLC_SIM_SYSCALL;
+}
+
+/*
+ * Fetch one decoded instruction and send it down the pipeline.
+ * Returns -1, without touching the cache or pipeline, if we don't know the
+ * instruction type.
+ */
+int iplc_sim_process_record(iplc_sim_t *sim, const iplc_sim_record_t *record)
+{
+    if (!iplc_sim_record_valid(record)) {
+        return -1;
+    }
+
+    IPLC_INSTRUMENT_BEGIN(IPLC_PHASE_PIPELINE);
+    iplc_sim_fetch_instruction(sim, record->instruction_address);
+
+    switch (record->type) {
+        case IPLC_SIM_RTYPE:
+            iplc_sim_process_pipeline_rtype(sim, "", record->dest_reg, record->src_reg, record->src_reg2);
+            break;
+        case IPLC_SIM_LW:
+            iplc_sim_process_pipeline_lw(sim, record->dest_reg, record->src_reg2, record->data_address);
+            break;
+        case IPLC_SIM_SW:
+            iplc_sim_process_pipeline_sw(sim, record->src_reg, record->src_reg2, record->data_address);
+            break;
+        case IPLC_SIM_BRANCH:
+            iplc_sim_process_pipeline_branch(sim, record->src_reg, record->src_reg2);
+            break;
+        case IPLC_SIM_JUMP:
+        case IPLC_SIM_JAL:
+            iplc_sim_process_pipeline_jump(sim, "");
+            break;
+        case IPLC_SIM_SYSCALL:
+            iplc_sim_process_pipeline_syscall(sim);
+            break;
+        case IPLC_SIM_NOP:
+            iplc_sim_process_pipeline_nop(sim);
+            break;
+    }
+    IPLC_INSTRUMENT_END(IPLC_PHASE_PIPELINE);
+    return 0;
+}
+
+/************************************************************************************************/
+/* Cache-only Functions *************************************************************************/
+/************************************************************************************************/
+
+/*
+ * iplc_sim_trap_address() for cache-only runs: no printing and no bus.
+ */
+int iplc_sim_trap_address_fast(iplc_sim_t *sim, unsigned int address)
+{
+    int index = (address >> sim->cache_blockoffsetbits) & sim->cache_index_mask;
+    int tag = address >> sim->cache_tag_shift;
+    int hit;
+
+    IPLC_INSTRUMENT_BEGIN(IPLC_PHASE_CACHE);
+    hit = iplc_sim_cache_lookup(sim, index, tag);
+    IPLC_INSTRUMENT_END(IPLC_PHASE_CACHE);
+    return hit;
+}
+
+/*
+ * The cache is shared by instructions and data, so to get the same hits and
+ * misses as the full model we have to make the same accesses in the same
+ * order.  That order only depends on when each instruction reaches MEM, which
+ * fetch misses and branch mispredictions move around.  This follows exactly
+ * those two things from iplc_sim_push_pipeline_stage() and skips the rest.
+ */
+void iplc_sim_push_cache_only(iplc_sim_t *sim)
+{
+    cache_only_stage_t *pipeline = sim->cache_only_pipeline;
+
+    //A misprediction moves everything past DECODE along a stage early
+    if (pipeline[DECODE].itype == BRANCH && pipeline[FETCH].instruction_address) {
+        int branch_taken = pipeline[DECODE].instruction_address + 4 != pipeline[FETCH].instruction_address;
+
+        if (branch_taken != sim->branch_predict_taken) {
+            pipeline[WRITEBACK] = pipeline[MEM];
+            pipeline[MEM] = pipeline[ALU];
+            pipeline[ALU] = pipeline[DECODE];
+            memset(&(pipeline[DECODE]), NOP, sizeof(cache_only_stage_t));
+        }
+    }
+
+    if (pipeline[MEM].itype == LW || pipeline[MEM].itype == SW) {
+        iplc_sim_trap_address_fast(sim, pipeline[MEM].data_address);
+    }
+
+    pipeline[WRITEBACK] = pipeline[MEM];
+    pipeline[MEM] = pipeline[ALU];
+    pipeline[ALU] = pipeline[DECODE];
+    pipeline[DECODE] = pipeline[FETCH];
+    memset(&(pipeline[FETCH]), NOP, sizeof(cache_only_stage_t));
+}
+
+void iplc_sim_drain_cache_only(iplc_sim_t *sim)
+{
+    while (sim->cache_only_pipeline[FETCH].itype != NOP  ||
+           sim->cache_only_pipeline[DECODE].itype != NOP ||
+           sim->cache_only_pipeline[ALU].itype != NOP    ||
+           sim->cache_only_pipeline[MEM].itype != NOP    ||
+           sim->cache_only_pipeline[WRITEBACK].itype != NOP) {
+        iplc_sim_push_cache_only(sim);
+    }
+}
+
+int iplc_sim_feed_cache_only(iplc_sim_t *sim, const iplc_sim_record_t *records, size_t count)
+{
+    const iplc_sim_record_t *record;
+    cache_only_stage_t *fetch = &sim->cache_only_pipeline[FETCH];
+    size_t i;
+    int j;
+
+    if (sim->cache == NULL) {
+        return -1;
+    }
+    for (i = 0; i < count; i++) {
+        if (!iplc_sim_record_valid(&records[i])) {
+            return -1;
+        }
+    }
+    sim->cache_only = 1;
+
+    IPLC_INSTRUMENT_BEGIN(IPLC_PHASE_PIPELINE);
+    for (i = 0; i < count; i++) {
+        record = &records[i];
+
+        //Same stall as iplc_sim_fetch_instruction()
+        if (!iplc_sim_trap_address_fast(sim, record->instruction_address)) {
+            for (j = 0; j < CACHE_MISS_DELAY - 1; j++) {
+                iplc_sim_push_cache_only(sim);
+            }
+        }
+        iplc_sim_push_cache_only(sim);
+
+        //Record types line up with ours, and JAL goes down the pipe as a JUMP
+        fetch->itype = record->type == IPLC_SIM_JAL ? JUMP : (enum instruction_type) record->type;
+        fetch->instruction_address = record->instruction_address;
+        fetch->data_address = record->data_address;
+    }
+    IPLC_INSTRUMENT_END(IPLC_PHASE_PIPELINE);
+    return 0;
 }
 
 /************************************************************************************************/
@@ -626,39 +1360,28 @@ unsigned int iplc_sim_parse_reg(char *reg_str)
 }
 
 /*
- * Don't touch this function.  It is for parsing the instruction stream.
+ * Turn one line of a text trace into a record.  Register fields the
+ * instruction doesn't use are left at -1.  Returns -1 if the line isn't an
+ * instruction we know; the caller knows where the line came from, so it
+ * says what went wrong.
  */
-void iplc_sim_parse_instruction(char *buffer)
+int iplc_sim_parse_instruction(char *buffer, iplc_sim_record_t *record)
 {
-    int instruction_hit = 0;
-    int i = 0, j = 0;
-    int src_reg = 0;
-    int src_reg2 = 0;
-    int dest_reg = 0;
+    char instruction[16];
+    char reg1[16];
+    char offsetwithreg[16];
     char str_src_reg[16];
     char str_src_reg2[16];
     char str_dest_reg[16];
     char str_constant[16];
 
-    if (sscanf(buffer, "%x %s", &instruction_address, instruction ) != 2) {
-        printf("Malformed instruction \n");
-        exit(-1);
-    }
-
-    instruction_hit = iplc_sim_trap_address(instruction_address);
-
-    // if a MISS, then push current instruction thru pipeline
-    if (!instruction_hit) {
-        // need to subtract 1, since the stage is pushed once more for actual instruction processing
-        // also need to allow for a branch miss prediction during the fetch cache miss time -- by
-        // counting cycles this allows for these cycles to overlap and not doubly count.
-
-        printf("INST MISS:\t Address 0x%x \n", instruction_address);
+    memset(record, 0, sizeof(iplc_sim_record_t));
+    record->dest_reg = -1;
+    record->src_reg = -1;
+    record->src_reg2 = -1;
 
-        for (i = pipeline_cycles, j = pipeline_cycles; i < j + CACHE_MISS_DELAY - 1; i++)
-            iplc_sim_push_pipeline_stage();
-    } else {
-        printf("INST HIT:\t Address 0x%x \n", instruction_address);
+    if (sscanf(buffer, "%x %15s", &record->instruction_address, instruction ) != 2) {
+        return -1;
     }
 
     // Parse the Instruction
@@ -666,74 +1389,58 @@ void iplc_sim_parse_instruction(char *buffer)
     if (strncmp( instruction, "add", 3 ) == 0 ||
         strncmp( instruction, "sll", 3 ) == 0 ||
         strncmp( instruction, "ori", 3 ) == 0) {
-        if (sscanf(buffer, "%x %s %s %s %s",
-                   &instruction_address,
+        if (sscanf(buffer, "%x %15s %15s %15s %15s",
+                   &record->instruction_address,
                    instruction,
                    str_dest_reg,
                    str_src_reg,
                    str_src_reg2 ) != 5) {
-            printf("Malformed RTYPE instruction (%s) at address 0x%x \n",
-                   instruction, instruction_address);
-            exit(-1);
+            return -1;
         }
 
-        dest_reg = iplc_sim_parse_reg(str_dest_reg);
-        src_reg = iplc_sim_parse_reg(str_src_reg);
-        src_reg2 = iplc_sim_parse_reg(str_src_reg2);
-
-        iplc_sim_process_pipeline_rtype(instruction, dest_reg, src_reg, src_reg2);
+        record->type = IPLC_SIM_RTYPE;
+        record->dest_reg = iplc_sim_parse_reg(str_dest_reg);
+        record->src_reg = iplc_sim_parse_reg(str_src_reg);
+        record->src_reg2 = iplc_sim_parse_reg(str_src_reg2);
     }
 
     else if (strncmp( instruction, "lui", 3 ) == 0) {
-        if (sscanf(buffer, "%x %s %s %s",
-                   &instruction_address,
+        if (sscanf(buffer, "%x %15s %15s %15s",
+                   &record->instruction_address,
                    instruction,
                    str_dest_reg,
                    str_constant ) != 4 ) {
-            printf("Malformed RTYPE instruction (%s) at address 0x%x \n",
-                   instruction, instruction_address );
-            exit(-1);
+            return -1;
         }
 
-        dest_reg = iplc_sim_parse_reg(str_dest_reg);
-        src_reg = -1;
-        src_reg2 = -1;
-        iplc_sim_process_pipeline_rtype(instruction, dest_reg, src_reg, src_reg2);
+        record->type = IPLC_SIM_RTYPE;
+        record->dest_reg = iplc_sim_parse_reg(str_dest_reg);
     }
 
     else if (strncmp( instruction, "lw", 2 ) == 0 ||
              strncmp( instruction, "sw", 2 ) == 0  ) {
-        if ( sscanf( buffer, "%x %s %s %s %x",
-                    &instruction_address,
+        if ( sscanf( buffer, "%x %15s %15s %15s %x",
+                    &record->instruction_address,
                     instruction,
                     reg1,
                     offsetwithreg,
-                    &data_address ) != 5) {
-            printf("Bad instruction: %s at address %x \n", instruction, instruction_address);
-            exit(-1);
+                    &record->data_address ) != 5) {
+            return -1;
         }
 
+        // don't need to worry about base regs -- just leave them at -1
         if (strncmp(instruction, "lw", 2 ) == 0) {
-            dest_reg = iplc_sim_parse_reg(reg1);
-
-            // don't need to worry about base regs -- just insert -1 values
-            iplc_sim_process_pipeline_lw(dest_reg, -1, data_address);
+            record->type = IPLC_SIM_LW;
+            record->dest_reg = iplc_sim_parse_reg(reg1);
         }
         if (strncmp( instruction, "sw", 2 ) == 0) {
-            src_reg = iplc_sim_parse_reg(reg1);
-
-            // don't need to worry about base regs -- just insert -1 values
-            iplc_sim_process_pipeline_sw(src_reg, -1, data_address);
+            record->type = IPLC_SIM_SW;
+            record->src_reg = iplc_sim_parse_reg(reg1);
         }
     }
     else if (strncmp( instruction, "beq", 3 ) == 0) {
-        // don't need to worry about getting regs -- just insert -1 values
-        iplc_sim_process_pipeline_branch(-1, -1);
-    }
-    else if (strncmp( instruction, "jal", 3 ) == 0 ||
-             strncmp( instruction, "jr", 2 ) == 0 ||
-             strncmp( instruction, "j", 1 ) == 0 ) {
-        iplc_sim_process_pipeline_jump(instruction);
+        // don't need to worry about getting regs -- just leave them at -1
+        record->type = IPLC_SIM_BRANCH;
     }
     else if (strncmp( instruction, "jal", 3 ) == 0 ||
              strncmp( instruction, "jr", 2 ) == 0 ||
@@ -742,59 +1449,297 @@ void iplc_sim_parse_instruction(char *buffer)
          * Note: no need to worry about forwarding on the jump register
          * we'll let that one go.
          */
-        iplc_sim_process_pipeline_jump(instruction);
+        record->type = IPLC_SIM_JUMP;
     }
     else if ( strncmp( instruction, "syscall", 7 ) == 0) {
-        iplc_sim_process_pipeline_syscall();
+        record->type = IPLC_SIM_SYSCALL;
     }
     else if ( strncmp( instruction, "nop", 3 ) == 0) {
-        iplc_sim_process_pipeline_nop();
+        record->type = IPLC_SIM_NOP;
     }
     else {
-        printf("Do not know how to process instruction: %s at address %x \n",
-               instruction, instruction_address );
-        exit(-1);
+        return -1;
     }
+
+    return 0;
 }
 
 /************************************************************************************************/
-/* MAIN Function ********************************************************************************/
+/* Library Functions ****************************************************************************/
 /************************************************************************************************/
 
-int main()
+iplc_sim_t *iplc_sim_create(void)
 {
-    char trace_file_name[1024];
-    FILE *trace_file = NULL;
-    char buffer[80];
-    int index = 10;
-    int blocksize = 1;
-    int assoc = 1;
+    iplc_sim_t *sim = (iplc_sim_t *) calloc(1, sizeof(iplc_sim_t));
 
-    printf("Please enter the tracefile: ");
-    scanf("%s", trace_file_name);
+    if (sim) {
+        iplc_sim_init_pipeline(sim);
+    }
+    return sim;
+}
 
-    trace_file = fopen(trace_file_name, "r");
+void iplc_sim_destroy(iplc_sim_t *sim)
+{
+    if (sim == NULL) {
+        return;
+    }
+    iplc_sim_free_cache(sim);
+    free(sim->bus_log);
+    free(sim);
+}
+
+int iplc_sim_configure(iplc_sim_t *sim, const iplc_sim_config_t *config)
+{
+    int status;
+
+    //Start over from nothing
+    iplc_sim_free_cache(sim);
+    memset(sim, 0, sizeof(iplc_sim_t));
+
+    sim->branch_predict_taken = config->branch_predict_taken;
+    sim->verbose = config->verbose;
 
-    if (trace_file == NULL) {
-        printf("fopen failed for %s file\n", trace_file_name);
-        exit(-1);
+    status = iplc_sim_init(sim, config->index, config->blocksize, config->assoc);
+    if (iplc_sim_init_issue(sim, config->issue_width, config->memory_ports, config->branch_units) != 0) {
+        status = -1;
     }
+    //Nothing gets fed to a context that didn't configure
+    if (status != 0) {
+        iplc_sim_free_cache(sim);
+    }
+    if (sim->verbose) {
+        iplc_sim_print_config(sim);
+    }
+    return status;
+}
 
-    printf("Enter Cache Size (index), Blocksize and Level of Assoc \n");
-    scanf("%d %d %d", &index, &blocksize, &assoc);
+int iplc_sim_feed(iplc_sim_t *sim, const iplc_sim_record_t *records, size_t count)
+{
+    size_t i;
 
-    printf("Enter Branch Prediction: 0 (NOT taken), 1 (TAKEN): ");
-    scanf("%d", &branch_predict_taken);
+    if (sim->cache == NULL) {
+        return -1;
+    }
+    //Check the whole batch first, so a bad one leaves the context untouched
+    for (i = 0; i < count; i++) {
+        if (!iplc_sim_record_valid(&records[i])) {
+            return -1;
+        }
+    }
+    for (i = 0; i < count; i++) {
+        iplc_sim_process_record(sim, &records[i]);
+    }
+    return 0;
+}
 
-    iplc_sim_init(index, blocksize, assoc);
+void iplc_sim_get_stats(const iplc_sim_t *sim, iplc_sim_stats_t *stats)
+{
+    stats->cache_access = sim->cache_access;
+    stats->cache_miss = sim->cache_miss;
+    stats->cache_hit = sim->cache_hit;
+    stats->pipeline_cycles = sim->pipeline_cycles;
+    stats->instruction_count = sim->instruction_count;
+    stats->branch_count = sim->branch_count;
+    stats->correct_branch_predictions = sim->correct_branch_predictions;
+    stats->coherence_miss = sim->coherence_miss;
+    stats->coherence_invalidations = sim->coherence_invalidations;
+    stats->coherence_transfers = sim->coherence_transfers;
+    stats->issue_width = sim->issue_width;
+    memcpy(stats->issue_cycles, sim->issue_cycles, sizeof(stats->issue_cycles));
+}
 
-    while (fgets(buffer, 80, trace_file) != NULL) {
-        iplc_sim_parse_instruction(buffer);
-        if (dump_pipeline) {
-            iplc_sim_dump_pipeline();
+/************************************************************************************************/
+/* Multi-core Functions *************************************************************************/
+/************************************************************************************************/
+
+static void iplc_sim_barrier_init(iplc_sim_barrier_t *barrier, int count)
+{
+    pthread_mutex_init(&barrier->lock, NULL);
+    pthread_cond_init(&barrier->everyone_here, NULL);
+    barrier->count = count;
+    barrier->waiting = 0;
+    barrier->round = 0;
+}
+
+static void iplc_sim_barrier_destroy(iplc_sim_barrier_t *barrier)
+{
+    pthread_cond_destroy(&barrier->everyone_here);
+    pthread_mutex_destroy(&barrier->lock);
+}
+
+// Wait until all count threads have called this, then let them all go
+static void iplc_sim_barrier_wait(iplc_sim_barrier_t *barrier)
+{
+    unsigned int round;
+
+    pthread_mutex_lock(&barrier->lock);
+    round = barrier->round;
+    if (++barrier->waiting == barrier->count) {
+        barrier->waiting = 0;
+        barrier->round++;
+        pthread_cond_broadcast(&barrier->everyone_here);
+    } else {
+        //Wake-ups can be spurious, so wait for the round to actually change
+        while (round == barrier->round) {
+            pthread_cond_wait(&barrier->everyone_here, &barrier->lock);
         }
     }
+    pthread_mutex_unlock(&barrier->lock);
+}
 
-    iplc_sim_finalize();
-    return 0;
+/*
+ * One host thread per simulated core.  Each core runs its own trace until its
+ * pipeline reaches the end of the current quantum, then waits at the barrier
+ * for everyone else so no core gets more than a quantum ahead of the others.
+ * Core 0 then puts the quantum's bus traffic on the bus for everyone.
+ */
+void *iplc_sim_core_thread(void *arg)
+{
+    iplc_sim_t *sim = (iplc_sim_t *) arg;
+    iplc_sim_system_t *system = sim->system;
+    unsigned int quantum_end = system->quantum;
+    iplc_sim_record_t record;
+    int i;
+
+    while (1) {
+        while (!sim->finished && sim->pipeline_cycles < quantum_end) {
+            if (iplc_trace_read(&sim->trace, &record, 1) == 0) {
+                if (sim->trace.error) {
+                    sim->failed = 1;
+                    sim->finished = 1;
+                    break;
+                }
+                //Out of trace, so empty the pipeline and sit out the rest
+                iplc_sim_drain_pipeline(sim);
+                sim->finished = 1;
+                break;
+            }
+            if (iplc_sim_process_record(sim, &record) != 0) {
+                //Give up on this core, but keep meeting the others at the barrier
+                sim->failed = 1;
+                sim->finished = 1;
+                break;
+            }
+        }
+
+        //Everyone has finished this quantum -- resolve the bus, and are any
+        // of us still going?
+        IPLC_INSTRUMENT_BEGIN(IPLC_PHASE_WAIT);
+        iplc_sim_barrier_wait(&system->quantum_barrier);
+        IPLC_INSTRUMENT_END(IPLC_PHASE_WAIT);
+        if (sim->core_id == 0) {
+            iplc_sim_coherence_resolve(system);
+            system->cores_running = 0;
+            for (i = 0; i < system->core_count; i++) {
+                if (!system->cores[i]->finished) {
+                    system->cores_running ++;
+                }
+            }
+        }
+        //Nobody may start the next quantum until that's done
+        IPLC_INSTRUMENT_BEGIN(IPLC_PHASE_WAIT);
+        iplc_sim_barrier_wait(&system->quantum_barrier);
+        IPLC_INSTRUMENT_END(IPLC_PHASE_WAIT);
+
+        if (system->cores_running == 0) {
+            break;
+        }
+        quantum_end += system->quantum;
+    }
+
+    IPLC_INSTRUMENT_THREAD_DONE();
+    return NULL;
+}
+
+/*
+ * Replay one trace per core, each core with its own pipeline and private
+ * cache, kept coherent with MESI on a shared snooping bus.
+ */
+int iplc_sim_run_multicore(int core_count, char **trace_file_names, const iplc_sim_config_t *config)
+{
+    iplc_sim_system_t system;
+    pthread_t threads[MAX_CORES];
+    long coherence_miss = 0;
+    int status = 0;
+    int i;
+
+    if (core_count > MAX_CORES) {
+        printf("Too many cores. Greater than MAX CORES of %d .... \n", MAX_CORES);
+        return -1;
+    }
+
+    memset(&system, 0, sizeof(iplc_sim_system_t));
+    system.core_count = core_count;
+    system.cores_running = core_count;
+    system.quantum = CORE_QUANTUM;
+
+    for (i = 0; i < core_count; i++) {
+        iplc_sim_t *core = iplc_sim_create();
+        core->system = &system;
+        core->core_id = i;
+        core->branch_predict_taken = config->branch_predict_taken;
+        if (iplc_sim_init(core, config->index, config->blocksize, config->assoc) != 0 ||
+            iplc_sim_init_issue(core, config->issue_width, config->memory_ports, config->branch_units) != 0) {
+            status = -1;
+        }
+        system.cores[i] = core;
+    }
+
+    // Every core has the same geometry, so only say it once
+    iplc_sim_print_config(system.cores[0]);
+
+    for (i = 0; i < core_count && status == 0; i++) {
+        if (iplc_trace_open(&system.cores[i]->trace, trace_file_names[i]) != 0) {
+            printf("fopen failed for %s file\n", trace_file_names[i]);
+            status = -1;
+        }
+    }
+
+    if (status == 0) {
+        iplc_sim_barrier_init(&system.quantum_barrier, core_count);
+
+        //The cores' threads time themselves; we'd only be timing the wait
+        IPLC_INSTRUMENT_PAUSE();
+        for (i = 0; i < core_count; i++) {
+            pthread_create(&threads[i], NULL, iplc_sim_core_thread, system.cores[i]);
+        }
+        for (i = 0; i < core_count; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        IPLC_INSTRUMENT_RESUME();
+        iplc_sim_barrier_destroy(&system.quantum_barrier);
+
+        for (i = 0; i < core_count; i++) {
+            if (system.cores[i]->trace.error) {
+                printf("Bad instruction at line %lu of %s \n", system.cores[i]->trace.line, trace_file_names[i]);
+                status = -1;
+            } else if (system.cores[i]->failed) {
+                printf("Bad record in %s \n", trace_file_names[i]);
+                status = -1;
+            }
+        }
+    }
+
+    if (status == 0) {
+        for (i = 0; i < core_count; i++) {
+            //A core that drained before the last quantum never pushes its
+            // pipeline again, so charge whatever the bus still owes it
+            system.cores[i]->pipeline_cycles += system.cores[i]->coherence_delay;
+            system.cores[i]->coherence_delay = 0;
+
+            printf("Core %d: %s \n", i, trace_file_names[i]);
+            iplc_sim_finalize(system.cores[i]);
+            coherence_miss += system.cores[i]->coherence_miss;
+        }
+
+        printf("System Performance \n");
+        printf("\t Number of Cores is %d \n", core_count);
+        printf("\t Total Coherence Misses is %ld \n\n", coherence_miss);
+    }
+
+    for (i = 0; i < core_count; i++) {
+        iplc_trace_close(&system.cores[i]->trace);
+        iplc_sim_destroy(system.cores[i]);
+    }
+    return status;
 }
@@ -0,0 +1,134 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- library interface
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_SIM_H
+#define IPLC_SIM_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Bump this whenever a change to the model changes any simulated result,
+ * so results saved by an older simulator are no longer trusted.
+ */
+#define IPLC_SIM_MODEL_VERSION 1
+
+// Most instructions the pipeline can fetch and issue in one cycle
+#define IPLC_SIM_MAX_ISSUE_WIDTH 8
+
+/*
+ * One simulated core: its cache, its pipeline and its counters.  Contexts
+ * share nothing, so any number of them can live in one process.
+ */
+typedef struct iplc_sim iplc_sim_t;
+
+/*
+ * Instruction types a record can carry.  These line up with the pipeline's
+ * own instruction types.
+ */
+enum iplc_sim_record_type
+{
+    IPLC_SIM_NOP,
+    IPLC_SIM_RTYPE,
+    IPLC_SIM_LW,
+    IPLC_SIM_SW,
+    IPLC_SIM_BRANCH,
+    IPLC_SIM_JUMP,
+    IPLC_SIM_JAL,
+    IPLC_SIM_SYSCALL
+};
+
+/*
+ * One already-decoded instruction, the same thing a line of a text trace
+ * turns into.  Registers not used by the type should be -1.
+ */
+typedef struct iplc_sim_record
+{
+    unsigned int instruction_address;
+    unsigned int data_address;  // LW and SW only
+    int type;                   // enum iplc_sim_record_type
+    int dest_reg;               // RTYPE and LW destination
+    int src_reg;                // RTYPE and BRANCH first source, SW register being stored
+    int src_reg2;               // RTYPE second source or constant, BRANCH second source, LW/SW base
+} iplc_sim_record_t;
+
+typedef struct iplc_sim_config
+{
+    int index;                  // log2 of the number of cache lines
+    int blocksize;              // words per block
+    int assoc;
+    unsigned int branch_predict_taken;
+    unsigned int verbose;       // print every access and hit/miss as it happens
+    int issue_width;            // instructions per cycle, up to IPLC_SIM_MAX_ISSUE_WIDTH (0 is 1)
+    int memory_ports;           // LW/SW per cycle (0 is 1)
+    int branch_units;           // branches and jumps per cycle (0 is 1)
+} iplc_sim_config_t;
+
+typedef struct iplc_sim_stats
+{
+    long cache_access;
+    long cache_miss;
+    long cache_hit;
+    unsigned int pipeline_cycles;
+    unsigned int instruction_count;
+    unsigned int branch_count;
+    unsigned int correct_branch_predictions;
+    long coherence_miss;
+    long coherence_invalidations;
+    long coherence_transfers;
+    int issue_width;
+    unsigned int issue_cycles[IPLC_SIM_MAX_ISSUE_WIDTH + 1]; // cycles that issued 0, 1, 2... instructions
+} iplc_sim_stats_t;
+
+// Context lifetime
+iplc_sim_t *iplc_sim_create(void);
+void iplc_sim_destroy(iplc_sim_t *sim);
+
+// Set up the cache and empty the pipeline.  Also resets every counter, so a
+// context can be reconfigured and reused.  Returns -1 if the cache is too big
+// or the issue width is more than IPLC_SIM_MAX_ISSUE_WIDTH.
+int iplc_sim_configure(iplc_sim_t *sim, const iplc_sim_config_t *config);
+
+// Run a batch of records through the model.  Returns -1 if any record in the
+// batch has an unknown type, or if the context hasn't been configured
+// successfully.  Either way none of the batch is used.
+int iplc_sim_feed(iplc_sim_t *sim, const iplc_sim_record_t *records, size_t count);
+
+// Cache accesses only, with no pipeline timing, for miss-rate studies.  The
+// accesses happen in the same order as iplc_sim_feed() makes them, so hit and
+// miss counts match a full single-issue run exactly; the pipeline counters
+// stay at zero.  The issue width is ignored.  Don't mix this with
+// iplc_sim_feed() on one context.  Bad batches are refused whole, the same as
+// iplc_sim_feed().
+int iplc_sim_feed_cache_only(iplc_sim_t *sim, const iplc_sim_record_t *records, size_t count);
+
+// Push whatever is still in the pipeline out through WRITEBACK
+void iplc_sim_drain_pipeline(iplc_sim_t *sim);
+
+// Counters as of now.  Drain first if you want the instructions still in flight.
+void iplc_sim_get_stats(const iplc_sim_t *sim, iplc_sim_stats_t *stats);
+
+// Text traces and printed output, as used by the simulator executable.  Both
+// print what was wrong and return -1 on bad input.
+int iplc_sim_parse_instruction(char *buffer, iplc_sim_record_t *record);
+int iplc_sim_dump_pipeline(iplc_sim_t *sim);
+void iplc_sim_finalize(iplc_sim_t *sim);
+void iplc_sim_print_stats(const iplc_sim_stats_t *stats, int coherence);
+void iplc_sim_print_cache_stats(const iplc_sim_stats_t *stats);
+
+// Replay one trace per core, with MESI-coherent private caches.  Returns -1
+// if there are too many traces, a trace can't be opened or has a bad record,
+// or the cache is too big.  The same traces always give the same results.
+int iplc_sim_run_multicore(int core_count, char **trace_file_names, const iplc_sim_config_t *config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IPLC_SIM_H
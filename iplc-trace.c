@@ -0,0 +1,93 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- trace files
+ ***********************************************************************/
+/***********************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "iplc-trace.h"
+#include "iplc-instrument.h"
+
+int iplc_trace_open(iplc_trace_t *trace, const char *path)
+{
+    char magic[IPLC_TRACE_MAGIC_SIZE];
+    uint32_t record_size;
+
+    trace->file = fopen(path, "rb");
+    trace->binary = 0;
+    trace->error = 0;
+    trace->line = 0;
+    if (trace->file == NULL) {
+        return -1;
+    }
+
+    //Anything without the magic is a text trace, so start it from the top
+    if (fread(magic, 1, IPLC_TRACE_MAGIC_SIZE, trace->file) != IPLC_TRACE_MAGIC_SIZE ||
+        memcmp(magic, IPLC_TRACE_MAGIC, IPLC_TRACE_MAGIC_SIZE) != 0) {
+        rewind(trace->file);
+        return 0;
+    }
+
+    trace->binary = 1;
+    if (fread(&record_size, sizeof(record_size), 1, trace->file) != 1 ||
+        record_size != sizeof(iplc_sim_record_t)) {
+        fclose(trace->file);
+        trace->file = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+void iplc_trace_close(iplc_trace_t *trace)
+{
+    if (trace->file) {
+        fclose(trace->file);
+        trace->file = NULL;
+    }
+}
+
+size_t iplc_trace_read(iplc_trace_t *trace, iplc_sim_record_t *records, size_t count)
+{
+    char buffer[80];
+    size_t i;
+
+    if (trace->error) {
+        return 0;
+    }
+
+    IPLC_INSTRUMENT_BEGIN(IPLC_PHASE_PARSE);
+    if (trace->binary) {
+        i = fread(records, sizeof(iplc_sim_record_t), count, trace->file);
+    } else {
+        for (i = 0; i < count; i++) {
+            if (fgets(buffer, 80, trace->file) == NULL) {
+                break;
+            }
+            trace->line++;
+            if (iplc_sim_parse_instruction(buffer, &records[i]) != 0) {
+                trace->error = 1;
+                break;
+            }
+        }
+    }
+    IPLC_INSTRUMENT_END(IPLC_PHASE_PARSE);
+    return i;
+}
+
+int iplc_trace_write_header(FILE *file)
+{
+    uint32_t record_size = sizeof(iplc_sim_record_t);
+
+    if (fwrite(IPLC_TRACE_MAGIC, 1, IPLC_TRACE_MAGIC_SIZE, file) != IPLC_TRACE_MAGIC_SIZE ||
+        fwrite(&record_size, sizeof(record_size), 1, file) != 1) {
+        return -1;
+    }
+    return 0;
+}
+
+int iplc_trace_write(FILE *file, const iplc_sim_record_t *records, size_t count)
+{
+    return fwrite(records, sizeof(iplc_sim_record_t), count, file) == count ? 0 : -1;
+}
@@ -0,0 +1,54 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- trace files
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_TRACE_H
+#define IPLC_TRACE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "iplc-sim.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Traces come either as text, one instruction per line like
+ * instruction-trace.txt, or pre-decoded: IPLC_TRACE_MAGIC, then the size of
+ * one record as a 32-bit int, then the records exactly as iplc_sim_record_t
+ * lays them out in memory.  Binary traces skip parsing altogether, but are
+ * only good on machines with the same byte order and record layout.
+ */
+#define IPLC_TRACE_MAGIC "IPLCBIN\n"
+#define IPLC_TRACE_MAGIC_SIZE 8
+
+typedef struct iplc_trace
+{
+    FILE *file;
+    int binary;
+    int error;              // a text line wouldn't parse
+    unsigned long line;     // text lines read so far, so the bad one if error is set
+} iplc_trace_t;
+
+// Opens either kind of trace.  Returns -1 if it can't be opened or a binary
+// trace has records of a different size.
+int iplc_trace_open(iplc_trace_t *trace, const char *path);
+void iplc_trace_close(iplc_trace_t *trace);
+
+// Read up to count records.  Returns how many were read, 0 at the end.  A
+// text line that won't parse ends the trace early with error set and line
+// pointing at it.  Nothing is printed; that's up to the caller.
+size_t iplc_trace_read(iplc_trace_t *trace, iplc_sim_record_t *records, size_t count);
+
+// Writing binary traces: the header once, then any number of records
+int iplc_trace_write_header(FILE *file);
+int iplc_trace_write(FILE *file, const iplc_sim_record_t *records, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IPLC_TRACE_H
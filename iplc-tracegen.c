@@ -0,0 +1,301 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- synthetic trace generator
+ ***********************************************************************/
+/***********************************************************************/
+#include <stdio.h>
+#include <string.h>
+
+#include "iplc-tracegen.h"
+
+#define STREAM_TEXT 0x00400000
+#define STRIDED_TEXT 0x00401000
+#define CHASE_TEXT 0x00402000
+#define LOOP_TEXT 0x00403000
+#define LOOP_FUNCTION_TEXT 0x00403800
+
+#define STREAM_SOURCE 0x10010000
+#define STREAM_DEST 0x10410000
+#define STREAM_BYTES (4 << 20)     // each array is 4MB, so it never fits in the cache
+#define STRIDED_DATA 0x10810000
+#define STRIDED_ROWS 256
+#define STRIDED_ROW_BYTES 1024     // one row is 256 words
+#define CHASE_DATA 0x10a10000
+#define CHASE_NODES 16384          // must be a power of two
+#define CHASE_NODE_BYTES 32
+#define STACK_TOP 0x7fffef00
+
+#define MIX_PHASE 4096             // average instructions between pattern switches
+
+static const char *pattern_names[IPLC_TRACEGEN_PATTERNS] = {
+    "stream", "strided", "pointer-chase", "loop", "mix"
+};
+
+int iplc_tracegen_pattern_from_name(const char *name)
+{
+    int i;
+    for (i = 0; i < IPLC_TRACEGEN_PATTERNS; i++) {
+        if (strcmp(name, pattern_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+const char *iplc_tracegen_pattern_name(int pattern)
+{
+    if (pattern < 0 || pattern >= IPLC_TRACEGEN_PATTERNS) return "unknown";
+    return pattern_names[pattern];
+}
+
+// xorshift32 -- small, fast and the same on every platform
+static unsigned int tracegen_random(iplc_tracegen_t *gen)
+{
+    gen->random ^= gen->random << 13;
+    gen->random ^= gen->random >> 17;
+    gen->random ^= gen->random << 5;
+    return gen->random;
+}
+
+void iplc_tracegen_init(iplc_tracegen_t *gen, int pattern, unsigned int seed)
+{
+    memset(gen, 0, sizeof(iplc_tracegen_t));
+    gen->pattern = pattern;
+    //xorshift gets stuck on zero
+    gen->random = seed ? seed : 0x9e3779b9;
+    gen->chase_node = tracegen_random(gen) & (CHASE_NODES - 1);
+
+    if (pattern == IPLC_TRACEGEN_MIX) {
+        gen->current = tracegen_random(gen) % IPLC_TRACEGEN_MIX;
+        gen->phase_left = MIX_PHASE / 2 + tracegen_random(gen) % MIX_PHASE;
+    } else {
+        gen->current = pattern;
+    }
+}
+
+/*
+ * Each pattern below emits the instruction at its current step of its loop
+ * body and moves on to the next step.  Branches are taken simply by making
+ * the next instruction something other than pc + 4, which is all the
+ * simulator looks at.
+ */
+
+static void tracegen_stream(iplc_tracegen_t *gen, char *buffer, size_t size)
+{
+    int step = gen->step[IPLC_TRACEGEN_STREAM];
+    unsigned int pc = STREAM_TEXT + 4 * step;
+    int next = step + 1;
+
+    switch (step) {
+        case 0:
+            snprintf(buffer, size, "0x%08x  lw $8, 0($4): %x\n", pc, STREAM_SOURCE + gen->stream_offset);
+            break;
+        case 1:
+            snprintf(buffer, size, "0x%08x  add $9, $9, $8\n", pc);
+            break;
+        case 2:
+            snprintf(buffer, size, "0x%08x  sw $9, 0($5): %x\n", pc, STREAM_DEST + gen->stream_offset);
+            break;
+        case 3:
+            snprintf(buffer, size, "0x%08x  addi $4, $4, 4\n", pc);
+            break;
+        case 4:
+            snprintf(buffer, size, "0x%08x  addi $5, $5, 4\n", pc);
+            gen->stream_offset = (gen->stream_offset + 4) % STREAM_BYTES;
+            break;
+        case 5:
+            //Leave the loop when we wrap back to the start of the arrays
+            snprintf(buffer, size, "0x%08x  beq $4, $6, 8\n", pc);
+            next = gen->stream_offset == 0 ? 7 : 6;
+            break;
+        case 6:
+            snprintf(buffer, size, "0x%08x  j 0x%08x\n", pc, STREAM_TEXT);
+            next = 0;
+            break;
+        case 7:
+            snprintf(buffer, size, "0x%08x  lui $4, 4097\n", pc);
+            break;
+        default:
+            snprintf(buffer, size, "0x%08x  j 0x%08x\n", pc, STREAM_TEXT);
+            next = 0;
+            break;
+    }
+    gen->step[IPLC_TRACEGEN_STREAM] = next;
+}
+
+static void tracegen_strided(iplc_tracegen_t *gen, char *buffer, size_t size)
+{
+    int step = gen->step[IPLC_TRACEGEN_STRIDED];
+    unsigned int pc = STRIDED_TEXT + 4 * step;
+    unsigned int address = STRIDED_DATA + gen->strided_row * STRIDED_ROW_BYTES + gen->strided_column * 4;
+    int next = step + 1;
+
+    switch (step) {
+        case 0:
+            snprintf(buffer, size, "0x%08x  lw $8, 0($4): %x\n", pc, address);
+            break;
+        case 1:
+            snprintf(buffer, size, "0x%08x  add $9, $9, $8\n", pc);
+            break;
+        case 2:
+            snprintf(buffer, size, "0x%08x  addi $4, $4, %d\n", pc, STRIDED_ROW_BYTES);
+            gen->strided_row = (gen->strided_row + 1) % STRIDED_ROWS;
+            break;
+        case 3:
+            //Bottom of the column, go start the next one
+            snprintf(buffer, size, "0x%08x  beq $4, $7, 8\n", pc);
+            next = gen->strided_row == 0 ? 5 : 4;
+            break;
+        case 4:
+            snprintf(buffer, size, "0x%08x  j 0x%08x\n", pc, STRIDED_TEXT);
+            next = 0;
+            break;
+        case 5:
+            snprintf(buffer, size, "0x%08x  addi $10, $10, 4\n", pc);
+            gen->strided_column = (gen->strided_column + 1) % (STRIDED_ROW_BYTES / 4);
+            break;
+        case 6:
+            snprintf(buffer, size, "0x%08x  add $4, $10, $0\n", pc);
+            break;
+        default:
+            snprintf(buffer, size, "0x%08x  j 0x%08x\n", pc, STRIDED_TEXT);
+            next = 0;
+            break;
+    }
+    gen->step[IPLC_TRACEGEN_STRIDED] = next;
+}
+
+static void tracegen_pointer_chase(iplc_tracegen_t *gen, char *buffer, size_t size)
+{
+    int step = gen->step[IPLC_TRACEGEN_POINTER_CHASE];
+    unsigned int pc = CHASE_TEXT + 4 * step;
+    unsigned int node = CHASE_DATA + gen->chase_node * CHASE_NODE_BYTES;
+    int next = step + 1;
+
+    switch (step) {
+        case 0:
+            snprintf(buffer, size, "0x%08x  lw $8, 0($4): %x\n", pc, node);
+            break;
+        case 1:
+            snprintf(buffer, size, "0x%08x  add $9, $9, $8\n", pc);
+            break;
+        case 2:
+            snprintf(buffer, size, "0x%08x  lw $4, 4($4): %x\n", pc, node + 4);
+            //Full-period LCG over the nodes, so the list is one big scattered cycle
+            gen->chase_node = (gen->chase_node * 1103515245 + 12345) & (CHASE_NODES - 1);
+            break;
+        case 3:
+            snprintf(buffer, size, "0x%08x  beq $4, $0, 8\n", pc);
+            break;
+        default:
+            snprintf(buffer, size, "0x%08x  j 0x%08x\n", pc, CHASE_TEXT);
+            next = 0;
+            break;
+    }
+    gen->step[IPLC_TRACEGEN_POINTER_CHASE] = next;
+}
+
+static void tracegen_loop(iplc_tracegen_t *gen, char *buffer, size_t size)
+{
+    int step = gen->step[IPLC_TRACEGEN_LOOP];
+    unsigned int pc = step < 8 ? LOOP_TEXT + 4 * step :
+                      step < 11 ? LOOP_FUNCTION_TEXT + 4 * (step - 8) :
+                      LOOP_TEXT + 4 * (step - 3);
+    unsigned int stack = STACK_TOP - 4 * (gen->loop_inner % 16);
+    int next = step + 1;
+
+    switch (step) {
+        case 0:
+            snprintf(buffer, size, "0x%08x  ori $10, $0, 8\n", pc);
+            gen->loop_inner = 8;
+            break;
+        case 1:
+            snprintf(buffer, size, "0x%08x  add $11, $11, $12\n", pc);
+            break;
+        case 2:
+            snprintf(buffer, size, "0x%08x  sll $13, $11, 2\n", pc);
+            break;
+        case 3:
+            snprintf(buffer, size, "0x%08x  lw $14, 0($29): %x\n", pc, stack);
+            break;
+        case 4:
+            snprintf(buffer, size, "0x%08x  addi $10, $10, -1\n", pc);
+            gen->loop_inner--;
+            break;
+        case 5:
+            snprintf(buffer, size, "0x%08x  beq $10, $0, 8\n", pc);
+            next = gen->loop_inner == 0 ? 7 : 6;
+            break;
+        case 6:
+            snprintf(buffer, size, "0x%08x  j 0x%08x\n", pc, LOOP_TEXT + 4);
+            next = 1;
+            break;
+        case 7:
+            snprintf(buffer, size, "0x%08x  jal 0x%08x\n", pc, LOOP_FUNCTION_TEXT);
+            break;
+        case 8:
+            snprintf(buffer, size, "0x%08x  addi $2, $2, 1\n", pc);
+            break;
+        case 9:
+            snprintf(buffer, size, "0x%08x  sw $2, 0($29): %x\n", pc, STACK_TOP);
+            break;
+        case 10:
+            snprintf(buffer, size, "0x%08x  jr $31\n", pc);
+            break;
+        case 11:
+            snprintf(buffer, size, "0x%08x  addi $15, $15, -1\n", pc);
+            gen->loop_outer++;
+            break;
+        case 12:
+            //Every 64 trips round the outer loop, go reset the counter
+            snprintf(buffer, size, "0x%08x  beq $15, $0, 8\n", pc);
+            next = gen->loop_outer % 64 == 0 ? 14 : 13;
+            break;
+        case 13:
+            snprintf(buffer, size, "0x%08x  j 0x%08x\n", pc, LOOP_TEXT);
+            next = 0;
+            break;
+        case 14:
+            snprintf(buffer, size, "0x%08x  ori $15, $0, 64\n", pc);
+            break;
+        default:
+            snprintf(buffer, size, "0x%08x  j 0x%08x\n", pc, LOOP_TEXT);
+            next = 0;
+            break;
+    }
+    gen->step[IPLC_TRACEGEN_LOOP] = next;
+}
+
+void iplc_tracegen_next(iplc_tracegen_t *gen, char *buffer, size_t size)
+{
+    if (gen->pattern == IPLC_TRACEGEN_MIX && gen->phase_left-- == 0) {
+        gen->current = tracegen_random(gen) % IPLC_TRACEGEN_MIX;
+        gen->phase_left = MIX_PHASE / 2 + tracegen_random(gen) % MIX_PHASE;
+    }
+
+    switch (gen->current) {
+        case IPLC_TRACEGEN_STREAM:
+            tracegen_stream(gen, buffer, size);
+            break;
+        case IPLC_TRACEGEN_STRIDED:
+            tracegen_strided(gen, buffer, size);
+            break;
+        case IPLC_TRACEGEN_POINTER_CHASE:
+            tracegen_pointer_chase(gen, buffer, size);
+            break;
+        default:
+            tracegen_loop(gen, buffer, size);
+            break;
+    }
+}
+
+void iplc_tracegen_write(FILE *file, int pattern, unsigned long length, unsigned int seed)
+{
+    iplc_tracegen_t gen;
+    char buffer[80];
+    unsigned long i;
+
+    iplc_tracegen_init(&gen, pattern, seed);
+    for (i = 0; i < length; i++) {
+        iplc_tracegen_next(&gen, buffer, sizeof(buffer));
+        fputs(buffer, file);
+    }
+}
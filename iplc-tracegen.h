@@ -0,0 +1,63 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- synthetic trace generator
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_TRACEGEN_H
+#define IPLC_TRACEGEN_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Access patterns we can generate.  Each one is a small loop of MIPS
+ * instructions in its own piece of the text segment, working on its own
+ * piece of the data segment.  MIX hops between the other four.
+ */
+enum iplc_tracegen_pattern
+{
+    IPLC_TRACEGEN_STREAM,       // walk two big arrays front to back
+    IPLC_TRACEGEN_STRIDED,      // walk a big matrix down its columns
+    IPLC_TRACEGEN_POINTER_CHASE,// follow a linked list scattered over the heap
+    IPLC_TRACEGEN_LOOP,         // tight nested loops and calls on a tiny working set
+    IPLC_TRACEGEN_MIX,
+    IPLC_TRACEGEN_PATTERNS
+};
+
+typedef struct iplc_tracegen
+{
+    int pattern;
+    int current;                // pattern being emitted right now (differs for MIX)
+    unsigned int random;        // xorshift state, so the same seed gives the same trace
+    unsigned long phase_left;   // MIX only: instructions until we switch patterns
+
+    int step[IPLC_TRACEGEN_MIX];// where each pattern is in its loop body
+    unsigned int stream_offset;
+    unsigned int strided_row;
+    unsigned int strided_column;
+    unsigned int chase_node;
+    unsigned int loop_inner;
+    unsigned int loop_outer;
+} iplc_tracegen_t;
+
+// Name <-> pattern, for command lines.  Unknown names give -1.
+int iplc_tracegen_pattern_from_name(const char *name);
+const char *iplc_tracegen_pattern_name(int pattern);
+
+void iplc_tracegen_init(iplc_tracegen_t *gen, int pattern, unsigned int seed);
+
+// Format the next instruction as a trace line (with its newline) into buffer
+void iplc_tracegen_next(iplc_tracegen_t *gen, char *buffer, size_t size);
+
+// Write length instructions of a whole trace to file
+void iplc_tracegen_write(FILE *file, int pattern, unsigned long length, unsigned int seed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IPLC_TRACEGEN_H
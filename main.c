@@ -0,0 +1,172 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator
+ ***********************************************************************/
+/***********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "iplc-sim.h"
+#include "iplc-result-cache.h"
+#include "iplc-trace.h"
+#include "iplc-instrument.h"
+
+#define RECORD_BATCH 4096
+
+unsigned int dump_pipeline = 1;
+
+/************************************************************************************************/
+/* MAIN Function ********************************************************************************/
+/************************************************************************************************/
+
+/*
+ * With no arguments, prompts for one trace and runs it on a single core.
+ * Given trace files on the command line, replays each one on its own core.
+ * Traces can be text or pre-decoded binary (see iplc-trace.h).
+ *
+ * Starting with -c runs just the cache on one trace, for when all you want
+ * is the miss rate.  The hits and misses are the same as a full run's.
+ *
+ * -w <width> models an in-order pipeline that fetches and issues up to that
+ * many instructions a cycle, with -m <ports> memory ports and -b <units>
+ * branch units (one of each unless given).
+ *
+ * If IPLC_SIM_RESULT_CACHE names a directory, single-core results are saved
+ * there, and a trace and configuration we've already simulated just prints
+ * the saved summary instead of running again.
+ *
+ * Built with IPLC_SIM_INSTRUMENT, a breakdown of where the simulator's own
+ * time went is printed to stderr at exit (see iplc-instrument.h).
+ */
+int main(int argc, char **argv)
+{
+    char trace_file_name[1024];
+    iplc_trace_t trace;
+    iplc_sim_t *sim = NULL;
+    iplc_sim_config_t config = { 10, 1, 1, 0, 1 };
+    static iplc_sim_record_t records[RECORD_BATCH];
+    size_t count;
+    iplc_sim_stats_t stats;
+    char *result_cache = getenv("IPLC_SIM_RESULT_CACHE");
+    unsigned long long trace_hash = 0;
+    int cache_only = 0;
+
+    IPLC_INSTRUMENT_START();
+
+    while (argc > 1 && argv[1][0] == '-') {
+        if (strcmp(argv[1], "-c") == 0) {
+            cache_only = 1;
+        } else if (argc > 2 && strcmp(argv[1], "-w") == 0) {
+            config.issue_width = atoi(argv[2]);
+        } else if (argc > 2 && strcmp(argv[1], "-m") == 0) {
+            config.memory_ports = atoi(argv[2]);
+        } else if (argc > 2 && strcmp(argv[1], "-b") == 0) {
+            config.branch_units = atoi(argv[2]);
+        } else {
+            printf("Unknown option %s. Options are -c, -w <width>, -m <ports> and -b <units> \n", argv[1]);
+            exit(-1);
+        }
+        //Options with a value use up two arguments
+        if (strcmp(argv[1], "-c") != 0) {
+            argc--;
+            argv++;
+        }
+        argc--;
+        argv++;
+    }
+
+    if (cache_only && argc > 1) {
+        printf("Cache-only runs take one trace, from the prompt \n");
+        exit(-1);
+    }
+    if (cache_only && config.issue_width > 1) {
+        printf("Cache-only runs are single-issue \n");
+        exit(-1);
+    }
+
+    if (argc == 1) {
+        printf("Please enter the tracefile: ");
+        scanf("%s", trace_file_name);
+
+        if (iplc_trace_open(&trace, trace_file_name) != 0) {
+            printf("fopen failed for %s file\n", trace_file_name);
+            exit(-1);
+        }
+    }
+
+    printf("Enter Cache Size (index), Blocksize and Level of Assoc \n");
+    scanf("%d %d %d", &config.index, &config.blocksize, &config.assoc);
+
+    printf("Enter Branch Prediction: 0 (NOT taken), 1 (TAKEN): ");
+    scanf("%u", &config.branch_predict_taken);
+
+    if (argc > 1) {
+        if (iplc_sim_run_multicore(argc - 1, argv + 1, &config) != 0) {
+            exit(-1);
+        }
+        return 0;
+    }
+
+    sim = iplc_sim_create();
+    if (iplc_sim_configure(sim, &config) != 0) {
+        exit(-1);
+    }
+
+    if (cache_only) {
+        //Big batches, since there's nothing to print between records
+        while ((count = iplc_trace_read(&trace, records, RECORD_BATCH)) > 0) {
+            if (iplc_sim_feed_cache_only(sim, records, count) != 0) {
+                printf("Bad record in %s \n", trace_file_name);
+                exit(-1);
+            }
+        }
+        if (trace.error) {
+            printf("Bad instruction at line %lu of %s \n", trace.line, trace_file_name);
+            exit(-1);
+        }
+        iplc_sim_drain_pipeline(sim);
+        iplc_sim_get_stats(sim, &stats);
+        iplc_sim_print_cache_stats(&stats);
+
+        iplc_sim_destroy(sim);
+        iplc_trace_close(&trace);
+        return 0;
+    }
+
+    if (result_cache && iplc_result_cache_hash_file(trace_file_name, &trace_hash) != 0) {
+        result_cache = NULL;
+    }
+    if (result_cache && iplc_result_cache_lookup(result_cache, trace_hash, &config, &stats)) {
+        printf("Using saved result for this trace and configuration \n");
+        iplc_sim_print_stats(&stats, 0);
+        iplc_sim_destroy(sim);
+        iplc_trace_close(&trace);
+        return 0;
+    }
+
+    while (iplc_trace_read(&trace, records, 1) == 1) {
+        if (iplc_sim_feed(sim, records, 1) != 0) {
+            printf("Bad record in %s \n", trace_file_name);
+            exit(-1);
+        }
+        if (dump_pipeline && iplc_sim_dump_pipeline(sim) != 0) {
+            exit(-1);
+        }
+    }
+    if (trace.error) {
+        printf("Bad instruction at line %lu of %s \n", trace.line, trace_file_name);
+        exit(-1);
+    }
+
+    iplc_sim_finalize(sim);
+    if (result_cache) {
+        iplc_sim_get_stats(sim, &stats);
+        if (iplc_result_cache_store(result_cache, trace_hash, &config, &stats) != 0) {
+            printf("Could not save result in %s \n", result_cache);
+        }
+    }
+    iplc_sim_destroy(sim);
+    iplc_trace_close(&trace);
+    return 0;
+}
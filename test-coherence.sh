@@ -0,0 +1,54 @@
+#!/bin/bash
+
+# Run as
+# ./test-coherence.sh "./a.out"
+# Where a.out is the compiled binary.
+# Replays a producer core that keeps storing to a small buffer against a
+# consumer core that keeps loading it, and checks the coherence counts and
+# the cycles they cost haven't changed.  Exits non-zero if they have.
+
+# CDs to the current directory of the file
+DIR=`echo $0 | sed -E 's/\/[^\/]+$/\//'`
+if [ "X$0" != "X$DIR" ]; then
+	cd "$DIR"
+fi
+
+EXECUTABLE=$1
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+# 8 accesses to 0x10010080.. then a jump back to the top, 500 times
+makeTrace() {
+	OP=$1
+	for ((i = 0; i < 500; i++)); do
+		for ((j = 0; j < 8; j++)); do
+			printf "0x%08x  %s \$8, %d(\$9): %08x\n" $((0x00400000 + j * 4)) $OP $((j * 4)) $((0x10010080 + j * 4))
+		done
+		printf "0x00400020  j 0x00400000\n"
+	done
+}
+
+makeTrace sw > "$WORK/producer.txt"
+makeTrace lw > "$WORK/consumer.txt"
+
+printf "6 1 1\n0\n" | "$EXECUTABLE" "$WORK/producer.txt" "$WORK/consumer.txt" > "$WORK/out.txt" || exit 1
+
+EXPECTED="$WORK/expected.txt"
+cat > "$EXPECTED" <<EOF
+	 Total Cycles is 8215
+	 Number of Coherence Misses is 0
+	 Number of Invalidations Sent is 32
+	 Number of Cache-to-Cache Transfers is 0
+	 Total Cycles is 8611
+	 Number of Coherence Misses is 32
+	 Number of Invalidations Sent is 0
+	 Number of Cache-to-Cache Transfers is 40
+	 Total Coherence Misses is 32
+EOF
+
+# The producer's first stores are handed to the consumer (8 transfers); after
+# that, every quantum the producer invalidates the consumer's 8 copies and
+# the consumer misses them back from the producer.  Every invalidation and
+# transfer costs its core bus cycles, including the consumer's last 8
+# transfers, which land after it has already drained.
+grep -E "Total Cycles|Coherence Misses|Invalidations|Transfers" "$WORK/out.txt" | sed 's/ *$//' | diff "$EXPECTED" - && echo "Coherence counts match"
@@ -0,0 +1,84 @@
+#!/bin/bash
+
+# Run as
+# ./test-issue.sh "./a.out"
+# Where a.out is the compiled binary.
+# Checks the totals and issue histogram of a couple of wider pipelines on
+# instruction-trace.txt haven't changed, and that saved results (including
+# ones saved before the issue width was a setting) are still read back.
+# Exits non-zero if anything is off.
+
+# CDs to the current directory of the file
+DIR=`echo $0 | sed -E 's/\/[^\/]+$/\//'`
+if [ "X$0" != "X$DIR" ]; then
+	cd "$DIR"
+fi
+
+EXECUTABLE=$1
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+STATUS=0
+
+# Totals and histogram for 6 1 1, branches predicted not taken
+runIt() {
+	printf "instruction-trace.txt\n6 1 1\n0\n" | "$EXECUTABLE" "$@" | \
+		grep -E "Using saved|Total Cycles|Total Instructions|CPI|Cycles Issuing|IPC" | sed 's/ *$//'
+}
+
+checkIt() {
+	NAME=$1
+	EXPECTED=$2
+	if diff "$EXPECTED" "$WORK/out.txt"; then
+		echo "$NAME matches"
+	else
+		echo "$NAME differs"
+		STATUS=1
+	fi
+}
+
+cat > "$WORK/w2.txt" <<EOF
+	 Total Cycles is 49252
+	 Total Instructions is 34753
+	 CPI is 1.417201
+	 Cycles Issuing 0 is 29035 (0.589519)
+	 Cycles Issuing 1 is 5681 (0.115346)
+	 Cycles Issuing 2 is 14536 (0.295135)
+	 IPC is 0.705616
+EOF
+runIt -w 2 -m 2 -b 1 > "$WORK/out.txt"
+checkIt "-w 2 -m 2 -b 1" "$WORK/w2.txt"
+
+cat > "$WORK/w4.txt" <<EOF
+	 Total Cycles is 47937
+	 Total Instructions is 34753
+	 CPI is 1.379363
+	 Cycles Issuing 0 is 29117 (0.607401)
+	 Cycles Issuing 1 is 8960 (0.186912)
+	 Cycles Issuing 2 is 4020 (0.083860)
+	 Cycles Issuing 3 is 5607 (0.116966)
+	 Cycles Issuing 4 is 233 (0.004861)
+	 IPC is 0.724972
+EOF
+runIt -w 4 > "$WORK/out.txt"
+checkIt "-w 4" "$WORK/w4.txt"
+
+# A saved wide run comes back with its histogram
+export IPLC_SIM_RESULT_CACHE="$WORK/results"
+mkdir "$IPLC_SIM_RESULT_CACHE"
+runIt -w 4 > /dev/null
+runIt -w 4 > "$WORK/out.txt"
+(echo "Using saved result for this trace and configuration"; cat "$WORK/w4.txt") > "$WORK/w4-saved.txt"
+checkIt "Saved -w 4 result" "$WORK/w4-saved.txt"
+
+# Entries saved before there was an issue width stop after the base counters
+rm -f "$IPLC_SIM_RESULT_CACHE"/*
+runIt > "$WORK/w1.txt"
+for ENTRY in "$IPLC_SIM_RESULT_CACHE"/*; do
+	head -13 "$ENTRY" > "$WORK/entry.txt"
+	mv "$WORK/entry.txt" "$ENTRY"
+done
+runIt > "$WORK/out.txt"
+(echo "Using saved result for this trace and configuration"; cat "$WORK/w1.txt") > "$WORK/w1-saved.txt"
+checkIt "Old-format saved result" "$WORK/w1-saved.txt"
+
+exit $STATUS
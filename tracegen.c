@@ -0,0 +1,104 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- synthetic trace generator
+
+ Run as
+ ./iplc-tracegen [-b] <pattern> <length> [seed] > trace.txt
+ where pattern is stream, strided, pointer-chase, loop or mix.  The same
+ pattern, length and seed always give the same trace.  With -b the trace
+ comes out pre-decoded (see iplc-trace.h) instead of as text.
+
+ ./iplc-tracegen convert <trace> > trace.bin
+ turns any text trace into a pre-decoded one.
+ ***********************************************************************/
+/***********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "iplc-tracegen.h"
+#include "iplc-trace.h"
+
+#define RECORD_BATCH 4096
+
+int tracegen_convert(const char *path)
+{
+    static iplc_sim_record_t records[RECORD_BATCH];
+    iplc_trace_t trace;
+    size_t count;
+
+    if (iplc_trace_open(&trace, path) != 0) {
+        fprintf(stderr, "fopen failed for %s file\n", path);
+        return -1;
+    }
+    iplc_trace_write_header(stdout);
+    while ((count = iplc_trace_read(&trace, records, RECORD_BATCH)) > 0) {
+        iplc_trace_write(stdout, records, count);
+    }
+    iplc_trace_close(&trace);
+    if (trace.error) {
+        fprintf(stderr, "Bad instruction at line %lu of %s\n", trace.line, path);
+        return -1;
+    }
+    return 0;
+}
+
+void tracegen_write_binary(int pattern, unsigned long length, unsigned int seed)
+{
+    iplc_tracegen_t gen;
+    iplc_sim_record_t record;
+    char buffer[80];
+    unsigned long i;
+
+    iplc_tracegen_init(&gen, pattern, seed);
+    iplc_trace_write_header(stdout);
+    for (i = 0; i < length; i++) {
+        iplc_tracegen_next(&gen, buffer, sizeof(buffer));
+        if (iplc_sim_parse_instruction(buffer, &record) != 0) {
+            fprintf(stderr, "Bad generated instruction: %s", buffer);
+            exit(-1);
+        }
+        iplc_trace_write(stdout, &record, 1);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int pattern;
+    unsigned long length;
+    unsigned int seed = 1;
+    int binary = 0;
+
+    if (argc == 3 && strcmp(argv[1], "convert") == 0) {
+        return tracegen_convert(argv[2]) == 0 ? 0 : -1;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "-b") == 0) {
+        binary = 1;
+        argc--;
+        argv++;
+    }
+
+    if (argc < 3 || argc > 4) {
+        printf("Usage: iplc-tracegen [-b] <stream|strided|pointer-chase|loop|mix> <length> [seed]\n");
+        printf("       iplc-tracegen convert <trace>\n");
+        exit(-1);
+    }
+
+    pattern = iplc_tracegen_pattern_from_name(argv[1]);
+    if (pattern == -1) {
+        printf("Unknown pattern: %s\n", argv[1]);
+        exit(-1);
+    }
+    length = strtoul(argv[2], NULL, 0);
+    if (argc == 4) {
+        seed = (unsigned int) strtoul(argv[3], NULL, 0);
+    }
+
+    if (binary) {
+        tracegen_write_binary(pattern, length, seed);
+    } else {
+        iplc_tracegen_write(stdout, pattern, length, seed);
+    }
+    return 0;
+}